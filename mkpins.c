@@ -34,6 +34,21 @@
 // 12. OD     Port Open Drain Mode (1=on)
 // 13. DEF    Desired Default (Initialized) State
 // 14. ACT    Signal is active high (1) or active low (0)
+//
+// Optional columns, found by name in the header row, in any position
+// after the fourteen above:
+//
+//     GROUP  Name of a multi-pin bus this signal belongs to; members are
+//            listed LSB first and must share a port
+//     IRQ    GPIO interrupt, RISE/FALL/BOTH:handler (ports 0 and 2 only)
+//     DEBOUNCE  1 (or Y) to include this input in the generated debouncer
+//     SLEEP_FUNC, SLEEP_DIR, SLEEP_MODE, SLEEP_DEF
+//            FUNC, IN/OUT, MODE and DEF to use while asleep, blank = same
+//
+// With -cpp a third file, prefix_gpio.hpp, holds typed C++11 pin templates.
+// With -blob variant, prefix_gpio_blob_variant.c and .bin hold the whole
+// configuration as data for zebra_gpio_blob_apply() to load at run time,
+// and prefix_gpio_blob_variant.h declares it.
 //************************************************************************
 
 
@@ -74,8 +89,50 @@ typedef struct tagPINDEF {
   int odrain;
   int def;
   int active;
+  char group[MAXCHARS];
+  char irq[MAXCHARS];          // raw IRQ column, EDGE:handler
+  int irq_edge;                // IRQ_RISE | IRQ_FALL, 0 if none
+  char irq_handler[MAXCHARS];
+  int debounce;
+  int sleep_func;  // NA where the sleep profile keeps the run setting
+  int sleep_inout;
+  int sleep_mode;
+  int sleep_def;
+  char softbus[MAXCHARS];      // raw SOFTBUS column, BUS:ROLE
 } PINDEF;
 
+#define IRQ_RISE (1)
+#define IRQ_FALL (2)
+
+#define MAXGROUPS (32)
+typedef struct tagGROUPDEF {
+  char name[MAXCHARS];
+  int port;
+  int nmembers;
+  int member[32];  // index into pins[], LSB first
+  bool valid;
+  bool scattered;  // members are not on consecutive bits
+  int nruns;       // runs of consecutive bits, for shift-mask access
+  bool lut;        // scattered, and lookup tables beat shift-mask runs
+} GROUPDEF;
+
+#define MAXSOFTBUS (8)
+#define SB_SPI (1)
+#define SB_I2C (2)
+#define SB_CLK  (0)  // roles, index into SOFTBUSDEF.pin[]
+#define SB_MOSI (1)
+#define SB_MISO (2)
+#define SB_CS   (3)
+#define SB_SDA  (4)
+#define SB_SCL  (5)
+#define SB_NROLES (6)
+typedef struct tagSOFTBUSDEF {
+  char name[MAXCHARS];
+  int type;              // SB_SPI or SB_I2C, from the roles used
+  int pin[SB_NROLES];    // index into pins[], -1 if the role is unused
+  bool valid;
+} SOFTBUSDEF;
+
 extern void print_file( FILE *fp, FILE *file2print );
 extern void print_headers_note( FILE *fp );
 extern void print_headers_c( FILE *fp );
@@ -84,6 +141,14 @@ extern void print_pindef_h( FILE *fp, PINDEF *pd );
 extern void print_pindef_c( FILE *fp, PINDEF *pd );
 extern void print_pinarray_h( FILE *fp );
 extern void print_pinarray_c( FILE *fp );
+extern bool need_stdint( void );
+extern int pin_flags( PINDEF *pd );
+extern void print_pinflags_h( FILE *fp );
+extern void print_soa_h( FILE *fp );
+extern void print_soa_array_c( FILE *fp, char *type, char *name, int which );
+extern void print_soa_c( FILE *fp );
+extern int strpool_add( char *str );
+extern void print_strpool_c( FILE *fp );
 
 extern void calc_PINSEL( void );
 extern void print_PINSEL( FILE *fp );
@@ -98,6 +163,125 @@ extern void print_FIOMASK( FILE *fp );
 
 extern void print_bit_macros( FILE *fp );
 extern void print_bit_defines( FILE *fp );
+extern void check_trace_names( void );
+extern void print_trace_h( FILE *fp );
+extern void print_trace_c( FILE *fp );
+
+extern void find_columns( char *lp );
+extern void calc_groups( void );
+extern unsigned long group_mask( GROUPDEF *gd );
+extern unsigned long group_invert( GROUPDEF *gd );
+extern void print_group_macros( FILE *fp );
+extern int group_lane( GROUPDEF *gd, int *base );
+extern int group_port_lanes( GROUPDEF *gd );
+extern int group_value_bytes( GROUPDEF *gd );
+extern const char *group_value_type( GROUPDEF *gd );
+extern bool any_lut_group( void );
+extern bool any_scattered_group( void );
+extern void print_group_scatter_h( FILE *fp, GROUPDEF *gd );
+extern void print_group_c( FILE *fp );
+extern void print_group_lane( FILE *fp, GROUPDEF *gd );
+
+extern bool need_device_h( void );
+extern bool port_used( int port );
+extern void print_txn_h( FILE *fp );
+extern void print_txn_c( FILE *fp );
+
+extern void calc_bulk( void );
+extern void print_bulk_h( FILE *fp );
+extern void print_bulk_c( FILE *fp );
+
+extern void calc_irq( void );
+extern bool any_irq( void );
+extern unsigned long irq_mask( int port, int edge );
+extern void print_irq_h( FILE *fp );
+extern void print_irq_c( FILE *fp );
+
+extern bool any_sleep( void );
+extern void calc_sleep( void );
+extern void print_sleep_h( FILE *fp );
+extern void print_sleep_c( FILE *fp );
+
+extern const char *pin_function_name( PINDEF *pd );
+extern void calc_PCONP( void );
+extern void print_PCONP( FILE *fp );
+extern int adc_channel( PINDEF *pd );
+extern unsigned long adc_channel_mask( void );
+extern void print_adc( FILE *fp );
+extern int timer_channel( PINDEF *pd, const char *fmt, int *timer );
+extern unsigned long pwm_channel_mask( void );
+extern bool any_timer_pin( void );
+extern void print_pwm_h( FILE *fp );
+extern void print_pwm_c( FILE *fp );
+extern void print_timer_h( FILE *fp );
+
+extern void check_debounce( void );
+extern unsigned long debounce_mask( int port );
+extern bool any_debounce( void );
+extern void print_debounce_h( FILE *fp );
+extern void print_debounce_c( FILE *fp );
+extern void print_cpp_hpp( FILE *fp );
+extern void print_cpp_pinset( FILE *fp );
+extern bool mux_name( PINDEF *pd, int func, char *name );
+extern void print_mux_h( FILE *fp );
+extern void print_mux_c( FILE *fp );
+extern void calc_softbus( void );
+extern bool any_softbus( void );
+extern bool any_softbus_type( int type );
+extern void print_softbus_h( FILE *fp );
+extern void print_softbus_c( FILE *fp );
+extern void softbus_ident( char *out, SOFTBUSDEF *sb, bool upper );
+extern unsigned long sb_mask( SOFTBUSDEF *sb, int role );
+extern int sb_port( SOFTBUSDEF *sb, int role );
+extern bool sb_bitband_write( SOFTBUSDEF *sb, int role );
+extern void sb_shift( char *out, const char *val, int from, int to );
+extern void print_softbus_read( FILE *fp, SOFTBUSDEF *sb, int role, int b );
+extern void print_softbus_generic( FILE *fp, int nstores, int nloads, int nreads );
+extern void print_softbus_spi( FILE *fp, SOFTBUSDEF *sb, char *BUS, char *bus );
+extern void print_softbus_i2c( FILE *fp, SOFTBUSDEF *sb, char *BUS, char *bus );
+extern void bb_word( char *out, unsigned long alias );
+extern void print_sim_hpp( FILE *fp );
+extern void print_sim_model_cpp( FILE *fp );
+extern void print_sim_trace( FILE *fp );
+extern void print_sim_generic( FILE *fp );
+extern void print_sim_generic_spi( FILE *fp );
+extern void print_sim_generic_i2c( FILE *fp );
+extern void print_sim_bench_generic( FILE *fp, const char *call );
+extern bool sim_gpio_out( PINDEF *pd );
+extern bool sim_gpio_od( PINDEF *pd );
+extern bool sim_gpio_in( PINDEF *pd );
+extern void print_sim_check_pins( FILE *fp );
+extern void print_sim_macros( FILE *fp );
+extern void print_sim_bench( FILE *fp, const char *call, const char *name );
+extern void print_sim_routines( FILE *fp );
+extern void print_sim_test( FILE *fp );
+extern unsigned long crc32_update( unsigned long crc, const unsigned char *p, int n );
+extern void build_blob( void );
+extern void print_blob_h( FILE *fp );
+extern void print_blob_c( FILE *fp );
+extern void print_blob_data_h( FILE *fp );
+extern void print_blob_data_c( FILE *fp );
+extern void write_blob_bin( FILE *fp );
+
+extern bool port_has_gpio( int port );
+extern void calc_POLARITY( void );
+extern void print_snapshot_h( FILE *fp );
+extern void print_snapshot_c( FILE *fp );
+
+extern unsigned long pinmode_image( int i );
+extern void print_ldm_bursts( FILE *fp, int nregs );
+extern int store_cost( unsigned long val, bool *have_zero );
+extern unsigned long bitband_alias( unsigned long addr, int bit );
+extern void print_bitband_defines( FILE *fp );
+extern void print_blockinit_h( FILE *fp );
+extern void print_blockinit_c( FILE *fp );
+extern void print_blockinit_cost( FILE *fp );
+
+extern void print_usage( void );
+extern int read_csv( FILE *fin );
+extern void clear_images( void );
+extern void set_prefix( char *name );
+extern int mkpins_diff( char *fname_old, char *fname_new );
 
 extern char* trim_lead( char *cp );
 extern char* trim_bom( char *cp );
@@ -116,6 +300,46 @@ unsigned long PINMODE_OD[5];
 unsigned long FIODIR[5];
 unsigned long FIOPIN[5];
 unsigned long FIOMASK[5];
+unsigned long OFF_SETMASK[5];
+unsigned long OFF_CLRMASK[5];
+unsigned long DEF_SETMASK[5];
+unsigned long DEF_CLRMASK[5];
+unsigned long POLARITY[5];
+
+// Optional column positions (-1 if the column isn't in the CSV)
+int col_group=-1;
+int col_irq=-1;
+int col_debounce=-1;
+int col_sleep_func=-1;
+int col_sleep_dir=-1;
+int col_sleep_mode=-1;
+int col_sleep_def=-1;
+int col_softbus=-1;
+int nfields=14;
+
+#define MAXFIELDS (32)
+typedef struct tagOPTCOL {
+  char *name;
+  int *col;
+} OPTCOL;
+
+OPTCOL optcols[] = {
+  { "GROUP", &col_group },
+  { "IRQ",   &col_irq },
+  { "DEBOUNCE", &col_debounce },
+  { "SLEEP_FUNC", &col_sleep_func },
+  { "SLEEP_DIR",  &col_sleep_dir },
+  { "SLEEP_MODE", &col_sleep_mode },
+  { "SLEEP_DEF",  &col_sleep_def },
+  { "SOFTBUS",    &col_softbus },
+  { NULL,    NULL }
+};
+
+GROUPDEF groups[MAXGROUPS];
+int ngroups;
+
+SOFTBUSDEF softbus[MAXSOFTBUS];
+int nsoftbus;
 
 // Project name prefix (keep it short)
 char prefix[MAXCHARS]; 
@@ -124,56 +348,103 @@ char PREFIX[MAXCHARS];
 char fname_in[MAXCHARS];
 char fname_out_c[MAXCHARS];
 char fname_out_h[MAXCHARS];
+char fname_out_hpp[MAXCHARS];
+char fname_out_blob_c[MAXCHARS];
+char fname_out_blob_h[MAXCHARS];
+char fname_out_blob_bin[MAXCHARS];
+char fname_out_sim_hpp[MAXCHARS];
+char fname_out_sim_cpp[MAXCHARS];
 char mkpins_date_time[MAXCHARS];
 
-int main( int argc, char *argv[] ) {
-  int i,j,k, cnt,br;
-  unsigned long lineno;
-  int seqno;
-  char *lp;
-  int beg,len;
-
-  PINDEF *pd, pindef;
-
-#define MAXFIELDS (16)
-  char *field_ptr[MAXFIELDS];
-  int field_beg[MAXFIELDS];
-  int field_len[MAXFIELDS];
-  char field[MAXCHARS];
+// Output options (see print_usage)
+bool opt_blockinit=false;  // PINCON register images + block-copy init
+bool opt_bitband=false;    // bit-band alias accessors
+bool opt_compact=false;    // packed PINDEF with pooled strings
+bool opt_nostrings=false;  // packed PINDEF without any strings
+bool opt_soa=false;        // structure-of-arrays pin tables
+bool opt_txn=false;        // shadow-register write-combining transactions
+bool opt_bulk=false;       // all-off / restore-defaults masks and routines
+bool opt_snapshot=false;   // batched, polarity-normalized input sampling
+bool opt_cpp=false;        // C++ header with typed pin templates
+bool opt_sim=false;        // host register simulator and self-test
+bool opt_trace=false;      // PREFIX_TRACE hooks in the pin macros
+bool opt_blob=false;       // runtime-loadable configuration blob
+bool opt_mux=false;        // per-signal PINSEL function switching
+bool opt_pconp=false;      // check a firmware PCONP value against the pinout
+unsigned long pconp_code;
+char blob_variant[MAXCHARS];
 
-  int itemp;
-  int okay;
+// String pool for the compact PINDEF layout
+#define MAXPOOL (MAXPINS*4*16)
+char strpool[MAXPOOL];
+int strpool_len;
 
-  int item;
-  int seq;
-  int pinnum;
-  int port;
-  int bit;
-  char altfunc1[MAXCHARS];
-  char altfunc2[MAXCHARS];
-  char altfunc3[MAXCHARS];
-  char signame[MAXCHARS];
-  int func;
-  int inout;
-  int mode;
-  int odrain;
-  int def;
-  int active;
-  FILE *fin, *foutc, *fouth;
+int main( int argc, char *argv[] ) {
+  int i;
+  FILE *fin, *foutc, *fouth, *fouthpp=NULL, *foutblob=NULL, *foutblobh=NULL, *foutbin=NULL;
+  FILE *foutsimh=NULL, *foutsimc=NULL;
   time_t tbeg;
   int exit_code=0;
+  int argn;
 
-  pd=&pindef;
   tbeg=time(NULL);
   strftime( mkpins_date_time, MAXCHARS, "%a %d-%b-%Y %H:%M:%S", localtime(&tbeg));
 
-  if(argc<3) {
-    fprintf(stderr,"Usage:   mkpins filename project-name\n");
-    fprintf(stderr,"e.g.,    mkpins pinout.csv zebra\n");
+  argn=1;
+  while((argn<argc) && (argv[argn][0]=='-')) {
+    if(0==strcmp(argv[argn],"-blockinit")) opt_blockinit=true;
+    else if(0==strcmp(argv[argn],"-bitband")) opt_bitband=true;
+    else if(0==strcmp(argv[argn],"-compact")) opt_compact=true;
+    else if(0==strcmp(argv[argn],"-nostrings")) opt_compact=opt_nostrings=true;
+    else if(0==strcmp(argv[argn],"-soa")) opt_soa=true;
+    else if(0==strcmp(argv[argn],"-txn")) opt_txn=true;
+    else if(0==strcmp(argv[argn],"-bulk")) opt_bulk=true;
+    else if(0==strcmp(argv[argn],"-snapshot")) opt_snapshot=true;
+    else if(0==strcmp(argv[argn],"-cpp")) opt_cpp=true;
+    else if(0==strcmp(argv[argn],"-mux")) opt_mux=true;
+    else if(0==strcmp(argv[argn],"-sim")) opt_sim=true;
+    else if(0==strcmp(argv[argn],"-trace")) opt_trace=true;
+    else if((0==strcmp(argv[argn],"-pconp")) && (argn+1<argc)) {
+      opt_pconp=true;
+      argn++;
+      pconp_code=strtoul( argv[argn], NULL, 0 );
+    }
+    else if((0==strcmp(argv[argn],"-blob")) && (argn+1<argc)) {
+      opt_blob=true;
+      argn++;
+      strncpy( blob_variant, argv[argn], MAXCHARS-1 );
+      for(i=0;blob_variant[i];i++) {
+        if(!isalnum(blob_variant[i]) && (blob_variant[i]!='_')) break;
+        blob_variant[i] = tolower(blob_variant[i]);
+      }
+      if((i==0) || blob_variant[i]) {
+        fprintf(stderr,"Error with blob variant name: %s\n", argv[argn] );
+        exit(99);
+      }
+    }
+    else {
+      fprintf(stderr,"Unknown option: %s\n", argv[argn] );
+      print_usage();
+      exit(99);
+    }
+    argn++;
+  }
+
+  if((argn<argc) && (0==strcmp(argv[argn],"diff"))) {
+    if((argc-argn)<4) {
+      print_usage();
+      exit(99);
+    }
+    set_prefix( argv[argn+3] );
+    exit( mkpins_diff( argv[argn+1], argv[argn+2] ) );
+  }
+
+  if((argc-argn)<2) {
+    print_usage();
     exit(99);
   }
 
-  strncpy( fname_in, argv[1], MAXCHARS );
+  strncpy( fname_in, argv[argn], MAXCHARS );
   fin = fopen( fname_in, "r" );
   if(!fin) {
     fprintf(stderr,"Error opening input file: %s\n", fname_in );
@@ -182,22 +453,15 @@ int main( int argc, char *argv[] ) {
     fprintf(stderr,"Opened input CSV file: %s\n", fname_in );
   }
 
-  strncpy( prefix, argv[2], MAXCHARS );
-  len = strlen(prefix);
-  for(i=0;i<len;i++) { // check and clean prefix
-    if(isprint(prefix[i])) { // simple check, should really be more thorough
-      prefix[i] = tolower(prefix[i]);
-      PREFIX[i] = toupper(prefix[i]);
-    } else {
-      break;
-    }
-  }
-  if(i<len) {
-    fprintf(stderr,"Error with project prefix: %s\n", argv[2] );
-    exit(99);
-  }
+  set_prefix( argv[argn+1] );
   sprintf( fname_out_c, "%s_gpio.c", prefix );
   sprintf( fname_out_h, "%s_gpio.h", prefix );
+  sprintf( fname_out_hpp, "%s_gpio.hpp", prefix );
+  sprintf( fname_out_blob_c, "%s_gpio_blob_%s.c", prefix, blob_variant );
+  sprintf( fname_out_blob_h, "%s_gpio_blob_%s.h", prefix, blob_variant );
+  sprintf( fname_out_blob_bin, "%s_gpio_blob_%s.bin", prefix, blob_variant );
+  sprintf( fname_out_sim_hpp, "%s_sim.hpp", prefix );
+  sprintf( fname_out_sim_cpp, "%s_sim.cpp", prefix );
   fprintf(stderr,"prefix: %s\n", prefix );
   fprintf(stderr,"PREFIX: %s\n", PREFIX );
 
@@ -216,26 +480,51 @@ int main( int argc, char *argv[] ) {
   } else {
     fprintf(stderr,"Opened for output H-File: %s\n", fname_out_h );
   }
-  
 
-  for(i=0;i<5;i++) {
-    PINMODE_OD[i]=0;
-    FIODIR[i]=0;
-    FIOPIN[i]=0;
-    FIOMASK[i]=0;
+  if(opt_cpp) {
+    fouthpp=fopen( fname_out_hpp, "w" );
+    if(!fouthpp) {
+      fprintf(stderr,"Error opening C++ header output file: %s\n", fname_out_hpp );
+      exit(99);
+    } else {
+      fprintf(stderr,"Opened for output C++ Header: %s\n", fname_out_hpp );
+    }
   }
 
-  for(i=0;i<11;i++) {
-    PINSEL[i]=0;
-    PINMODE[i]=0;
+  if(opt_blob) {
+    foutblob=fopen( fname_out_blob_c, "w" );
+    foutblobh=fopen( fname_out_blob_h, "w" );
+    foutbin=fopen( fname_out_blob_bin, "wb" );
+    if(!foutblob || !foutblobh || !foutbin) {
+      fprintf(stderr,"Error opening blob output files: %s, %s, %s\n", fname_out_blob_c, fname_out_blob_h, fname_out_blob_bin );
+      exit(99);
+    } else {
+      fprintf(stderr,"Opened for output blob: %s, %s, %s\n", fname_out_blob_c, fname_out_blob_h, fname_out_blob_bin );
+    }
   }
 
+  if(opt_sim) {
+    foutsimh=fopen( fname_out_sim_hpp, "w" );
+    foutsimc=fopen( fname_out_sim_cpp, "w" );
+    if(!foutsimh || !foutsimc) {
+      fprintf(stderr,"Error opening simulator output files: %s, %s\n", fname_out_sim_hpp, fname_out_sim_cpp );
+      exit(99);
+    } else {
+      fprintf(stderr,"Opened for output simulator: %s, %s\n", fname_out_sim_hpp, fname_out_sim_cpp );
+    }
+  }
+  
 
-  seqno=0; // keeps track of entries actually saved and stored
-  lineno=0; // keeps track of line number on input file
-  fgets( line, MAXCHARS, fin );  // read and ignore (header)
-  lp=trim_bom( line ); // we don't need header, but just in case, don't forget BOM
-  lineno++;
+  clear_images();
+  exit_code=read_csv( fin );
+  if(exit_code) goto MYEXIT;
+
+  // things the file headers depend on
+  calc_irq();
+  check_debounce();
+  calc_groups();
+  calc_softbus();
+  if(opt_trace) check_trace_names();
 
   print_headers_note( foutc );
   print_headers_c( foutc );
@@ -243,9 +532,207 @@ int main( int argc, char *argv[] ) {
   print_headers_note( fouth );
   print_headers_h( fouth );
 
+  for(i=0;i<nseqs;i++) {
+    print_pindef_h( fouth, &pins[i] );
+    print_pindef_c( foutc, &pins[i] );
+  }
+
+  print_pinarray_h( fouth );
+  print_pinarray_c( foutc );
+  if(opt_compact && !opt_nostrings) print_strpool_c( foutc );
+  if(opt_soa) {
+    print_soa_h( fouth );
+    print_soa_c( foutc );
+  }
+
+  // the rest are just #defines, all go in the header
+  calc_PINSEL();
+  print_PINSEL( fouth );
+
+  calc_PINMODE();
+  print_PINMODE( fouth );
+
+  if(opt_blockinit) {
+    print_blockinit_h( fouth );
+    print_blockinit_c( foutc );
+    print_blockinit_cost( fouth );
+  }
+
+  calc_FIODIR();
+  print_FIODIR( fouth );
+
+  calc_FIOPIN();
+  print_FIOPIN( fouth );
+
+  calc_FIOMASK();
+  print_FIOMASK( fouth );
+
+  calc_PCONP();
+  print_PCONP( fouth );
+
+  if(adc_channel_mask()) print_adc( fouth );
+
+  print_bit_defines( fouth );
+  if(opt_bitband) print_bitband_defines( fouth );
+  if(opt_trace) {
+    print_trace_h( fouth );
+    print_trace_c( foutc );
+  }
+  print_bit_macros( fouth );
+
+  print_group_macros( fouth );
+  print_group_c( foutc );
+
+  if(opt_txn) {
+    print_txn_h( fouth );
+    print_txn_c( foutc );
+  }
+
+  if(opt_bulk) {
+    calc_bulk();
+    print_bulk_h( fouth );
+    print_bulk_c( foutc );
+  }
+
+  if(opt_snapshot) {
+    calc_POLARITY();
+    print_snapshot_h( fouth );
+    print_snapshot_c( foutc );
+  }
+
+  if(any_irq()) {
+    print_irq_h( fouth );
+    print_irq_c( foutc );
+  }
+
+  if(any_debounce()) {
+    calc_POLARITY();
+    print_debounce_h( fouth );
+    print_debounce_c( foutc );
+  }
+
+  if(any_sleep()) {
+    calc_sleep();
+    print_sleep_h( fouth );
+    print_sleep_c( foutc );
+  }
+
+  if(pwm_channel_mask()) {
+    print_pwm_h( fouth );
+    print_pwm_c( foutc );
+  }
+  if(any_timer_pin()) print_timer_h( fouth );
+
+  if(opt_mux) {
+    print_mux_h( fouth );
+    print_mux_c( foutc );
+  }
+
+  if(any_softbus()) {
+    print_softbus_h( fouth );
+    print_softbus_c( foutc );
+  }
+
+  if(opt_blob) {
+    build_blob();
+    print_blob_h( fouth );
+    print_blob_c( foutc );
+  }
+
+  print_file( fouth, fin );
+
+  if(opt_cpp) {
+    print_headers_note( fouthpp );
+    print_cpp_hpp( fouthpp );
+  }
+
+  if(opt_blob) {
+    print_headers_note( foutblobh );
+    print_blob_data_h( foutblobh );
+    print_headers_note( foutblob );
+    print_blob_data_c( foutblob );
+    write_blob_bin( foutbin );
+  }
+
+  if(opt_sim) {
+    print_headers_note( foutsimh );
+    print_sim_hpp( foutsimh );
+    print_headers_note( foutsimc );
+    print_sim_model_cpp( foutsimc );
+    print_sim_test( foutsimc );
+  }
+
+  exit_code=0;
+  goto MYEXIT;
+
+MYEXIT:
+  fclose(fin);
+  fclose(foutc);
+  fclose(fouth);
+  if(fouthpp) fclose(fouthpp);
+  if(foutblob) fclose(foutblob);
+  if(foutblobh) fclose(foutblobh);
+  if(foutbin) fclose(foutbin);
+  if(foutsimh) fclose(foutsimh);
+  if(foutsimc) fclose(foutsimc);
+  exit(exit_code);
+}
+
+// Reads the pin CSV into pins[] and nseqs.  Returns 0, or 99 after
+// reporting a malformed row.
+int read_csv( FILE *fin ) {
+  int i,j,k, cnt,br;
+  unsigned long lineno;
+  int seqno;
+  char *lp, *lp2;
+  int beg,len;
+
+  PINDEF *pd, pindef;
+
+  char *field_ptr[MAXFIELDS];
+  int field_beg[MAXFIELDS];
+  int field_len[MAXFIELDS];
+  char field[MAXCHARS];
+
+  int itemp;
+  int okay;
+
+  int item;
+  int seq;
+  int pinnum;
+  int port;
+  int bit;
+  char altfunc1[MAXCHARS];
+  char altfunc2[MAXCHARS];
+  char altfunc3[MAXCHARS];
+  char signame[MAXCHARS];
+  int func;
+  int inout;
+  int mode;
+  int odrain;
+  int def;
+  int active;
+  char group[MAXCHARS];
+  char irq[MAXCHARS];
+  char sbus[MAXCHARS];
+  int debounce;
+  int sleep_func, sleep_inout, sleep_mode, sleep_def;
+
+  pd=&pindef;
+  nfields=14;
+  for(i=0;optcols[i].name;i++) *optcols[i].col=-1;
+
+  seqno=0; // keeps track of entries actually saved and stored
+  lineno=0; // keeps track of line number on input file
+  fgets( line, MAXCHARS, fin );  // header, only used to find optional columns
+  lp=trim_bom( line ); // don't forget BOM
+  find_columns( lp );
+  lineno++;
+
   while( fgets( line, MAXCHARS, fin ) ) {
     lp=line;
     if(0==strncmp(line,"END", 3)) break;
+    trim_eoline( lp );
     lineno++;
 
     item=0;
@@ -258,6 +745,9 @@ int main( int argc, char *argv[] ) {
       altfunc2[i]=0;
       altfunc3[i]=0;
       signame[i]=0;
+      group[i]=0;
+      irq[i]=0;
+      sbus[i]=0;
     }
     func=NA;
     inout=NA;
@@ -265,15 +755,17 @@ int main( int argc, char *argv[] ) {
     odrain=0;
     def=0;
     active=1;
+    debounce=0;
+    sleep_func=sleep_inout=sleep_mode=sleep_def=NA;
 
-    for(i=0;i<16;i++) {
+    for(i=0;i<MAXFIELDS;i++) {
       field_ptr[i]=(char *)(0);
       field_beg[i]=0;
       field_len[i]=0;
     }
     
     beg=0;
-    for(i=0;i<14;i++) {
+    for(i=0;i<nfields;i++) {
 
       len = strcspn(lp+beg,",");
 
@@ -339,6 +831,26 @@ int main( int argc, char *argv[] ) {
         if(i==13) {
           if(1==sscanf(field,"%d",&itemp)) active = itemp;
         }
+        if(i==col_group) strncpy(group,trim_lead(field),MAXCHARS);
+        if(i==col_irq) strncpy(irq,trim_lead(field),MAXCHARS);
+        if(i==col_softbus) strncpy(sbus,trim_lead(field),MAXCHARS);
+        if(i==col_debounce) {
+          lp2=trim_lead(field);
+          if((1==sscanf(lp2,"%d",&itemp)) && (itemp!=0)) debounce = 1;
+          if((toupper(lp2[0])=='Y')) debounce = 1;
+        }
+        if(i==col_sleep_func) {
+          if(1==sscanf(field,"%d",&itemp)) sleep_func = itemp;
+        }
+        if(i==col_sleep_dir) {
+          if(1==sscanf(field,"%d",&itemp)) sleep_inout = itemp;
+        }
+        if(i==col_sleep_mode) {
+          if(1==sscanf(field,"%d",&itemp)) sleep_mode = itemp;
+        }
+        if(i==col_sleep_def) {
+          if(1==sscanf(field,"%d",&itemp)) sleep_def = itemp;
+        }
       }
       if(lp[beg+len] != '\0') beg += len + 1;
       else                    beg += len;
@@ -362,9 +874,17 @@ int main( int argc, char *argv[] ) {
     pd->odrain=odrain;
     pd->def=def;
     pd->active=active;
-
-    print_pindef_h( fouth, pd );
-    print_pindef_c( foutc, pd );
+    trim_trail(group);
+    strncpy(pd->group,group,MAXCHARS);
+    trim_trail(irq);
+    strncpy(pd->irq,irq,MAXCHARS);
+    pd->debounce=debounce;
+    pd->sleep_func=sleep_func;
+    pd->sleep_inout=sleep_inout;
+    pd->sleep_mode=sleep_mode;
+    pd->sleep_def=sleep_def;
+    trim_trail(sbus);
+    strncpy(pd->softbus,sbus,MAXCHARS);
 
     pins[seqno]=pindef; // save to array of pin defs
     seqno++;
@@ -373,45 +893,66 @@ int main( int argc, char *argv[] ) {
   }
   nseqs = seqno;
   fprintf(stderr, "Processed %d entries in %ld lines\n", nseqs, lineno);
+  return 0;
 
-  print_pinarray_h( fouth );
-  print_pinarray_c( foutc );
-
-  // the rest are just #defines, all go in the header
-  calc_PINSEL();
-  print_PINSEL( fouth );
+MYERROR:
+  fprintf(stderr,"Error: line %ld, Field %d, String %s\n", lineno, i, field );
+  return 99;
+}
 
-  calc_PINMODE();
-  print_PINMODE( fouth );
+void set_prefix( char *name ) {
+  int i, len;
+  strncpy( prefix, name, MAXCHARS );
+  len = strlen(prefix);
+  for(i=0;i<len;i++) { // check and clean prefix
+    if(isprint(prefix[i])) { // simple check, should really be more thorough
+      prefix[i] = tolower(prefix[i]);
+      PREFIX[i] = toupper(prefix[i]);
+    } else {
+      break;
+    }
+  }
+  if(i<len) {
+    fprintf(stderr,"Error with project prefix: %s\n", name );
+    exit(99);
+  }
+}
 
-  calc_FIODIR();
-  print_FIODIR( fouth );
+void clear_images( void ) {
+  int i;
+  for(i=0;i<5;i++) {
+    PINMODE_OD[i]=0;
+    FIODIR[i]=0;
+    FIOPIN[i]=0;
+    FIOMASK[i]=0;
+  }
 
-  calc_FIOPIN();
-  print_FIOPIN( fouth );
+  for(i=0;i<11;i++) {
+    PINSEL[i]=0;
+    PINMODE[i]=0;
+  }
+}
 
-  calc_FIOMASK();
-  print_FIOMASK( fouth );
-
-  print_bit_defines( fouth );
-  print_bit_macros( fouth );
-
-  print_file( fouth, fin );
-
-  exit_code=0;
-  goto MYEXIT;
-
-MYERROR:
-  fprintf(stderr,"Error: line %ld, Field %d, String %s\n", lineno, i, field );
-  exit_code=99;
-
-
-MYEXIT:
-  fclose(fin);
-  fclose(foutc);
-  fclose(fouth);
-  exit(exit_code);
-}
+void print_usage( void ) {
+  fprintf(stderr,"Usage:   mkpins [options] filename project-name\n");
+  fprintf(stderr,"e.g.,    mkpins pinout.csv zebra\n");
+  fprintf(stderr,"         mkpins diff old.csv new.csv project-name\n");
+  fprintf(stderr,"Options:\n");
+  fprintf(stderr,"  -blockinit   PINCON register images with block-copy init routine\n");
+  fprintf(stderr,"  -bitband     bit-band alias accessors for FIOPIN/FIODIR/PINMODE_OD bits\n");
+  fprintf(stderr,"  -compact     packed PINDEF layout, strings pooled into one blob\n");
+  fprintf(stderr,"  -nostrings   packed PINDEF layout without the string fields\n");
+  fprintf(stderr,"  -soa         structure-of-arrays pin tables indexed by a pin enum\n");
+  fprintf(stderr,"  -txn         staged set/clear with begin/commit, two stores per port\n");
+  fprintf(stderr,"  -bulk        all-outputs-off and restore-defaults masks and routines\n");
+  fprintf(stderr,"  -snapshot    sample each port once into a logical-level snapshot\n");
+  fprintf(stderr,"  -cpp         also write prefix_gpio.hpp with typed C++ pin templates\n");
+  fprintf(stderr,"  -blob name   also write a loadable configuration blob for board variant name\n");
+  fprintf(stderr,"  -mux         routines to switch each signal between GPIO and its FUNC1..3\n");
+  fprintf(stderr,"  -sim         also write prefix_sim.hpp/.cpp, a host register model and self-test\n");
+  fprintf(stderr,"  -pconp value warn about peripherals the firmware powers but the pinout doesn't use\n");
+  fprintf(stderr,"  -trace       pin macros log to a ring buffer when built with PREFIX_TRACE\n");
+}
 
 void print_file( FILE *fp, FILE *file2print ) {
   unsigned long lineno;
@@ -443,18 +984,80 @@ void print_headers_note( FILE *fp ) {
   fprintf( fp, "//***  Project Name Prefix:      %s\n", PREFIX );
   fprintf( fp, "//***  Output C-File:            %s\n", fname_out_c );
   fprintf( fp, "//***  Output H-File:            %s\n", fname_out_h );
+  if(opt_cpp) {
+    fprintf( fp, "//***  Output C++ Header:        %s\n", fname_out_hpp );
+  }
+  if(opt_blob) {
+    fprintf( fp, "//***  Output Blob:              %s, %s, %s\n", fname_out_blob_c, fname_out_blob_h, fname_out_blob_bin );
+  }
+  if(opt_sim) {
+    fprintf( fp, "//***  Output Simulator:         %s, %s\n", fname_out_sim_hpp, fname_out_sim_cpp );
+  }
   fprintf( fp, "//***\n");
   fprintf( fp, "//************************************************************************\n"); 
   fprintf( fp, "//************************************************************************\n"); 
   fprintf( fp, "\n");
 }
 
+// generated routines in the C file touch the registers directly
+bool need_device_h( void ) {
+  return opt_blockinit || opt_txn || opt_bulk || opt_snapshot || any_irq() ||
+         any_debounce() || any_scattered_group() || opt_blob || any_sleep() ||
+         opt_mux || (pwm_channel_mask()!=0) || any_softbus() || opt_trace;
+}
+
 void print_headers_c( FILE *fp ) {
+  if(opt_sim) {
+    fprintf( fp, "#ifdef %s_SIM\n", PREFIX );
+    fprintf( fp, "#include \"%s\"\n", fname_out_sim_hpp );
+    if(need_device_h()) {
+      fprintf( fp, "#else\n");
+      fprintf( fp, "#include \"LPC17xx.h\"\n" );
+    }
+    fprintf( fp, "#endif\n");
+  } else if(need_device_h()) {
+    fprintf( fp, "#include \"LPC17xx.h\"\n" );
+  }
   fprintf( fp, "#include \"%s\"\n", fname_out_h );
   fprintf( fp, "\n");
 }
 
+bool need_stdint( void ) {
+  return opt_blockinit || opt_bitband || opt_compact || opt_soa || opt_txn ||
+         opt_snapshot || any_debounce() || any_lut_group() || opt_blob ||
+         any_sleep() || (pwm_channel_mask()!=0) || any_softbus() || opt_trace;
+}
+
 void print_headers_h( FILE *fp ) {
+  if(need_stdint()) {
+    fprintf( fp, "#include <stdint.h>\n");
+    fprintf( fp, "\n");
+  }
+  if(opt_compact) {
+    print_pinflags_h( fp );
+    fprintf( fp, "typedef struct tag%s_PINDEF {  // %d bytes\n", PREFIX, opt_nostrings ? 8 : 16 );
+    fprintf( fp, "  uint16_t pinnum;\n");
+    fprintf( fp, "  uint8_t seq;\n");
+    fprintf( fp, "  uint8_t port;\n");
+    fprintf( fp, "  uint8_t bit;\n");
+    fprintf( fp, "  uint8_t func;\n");
+    fprintf( fp, "  uint8_t mode;\n");
+    fprintf( fp, "  uint8_t flags;\n");
+    if(!opt_nostrings) {
+      fprintf( fp, "  uint16_t altfunc1;  // offsets into %s_STRPOOL\n", PREFIX );
+      fprintf( fp, "  uint16_t altfunc2;\n");
+      fprintf( fp, "  uint16_t altfunc3;\n");
+      fprintf( fp, "  uint16_t signame;\n");
+    }
+    fprintf( fp, "} %s_PINDEF;\n", PREFIX );
+    fprintf( fp, "\n");
+    if(!opt_nostrings) {
+      fprintf( fp, "extern const char %s_STRPOOL[];\n", PREFIX );
+      fprintf( fp, "#define %s_PD_STR(off) (&%s_STRPOOL[(off)])\n", PREFIX, PREFIX );
+      fprintf( fp, "\n");
+    }
+    return;
+  }
   fprintf( fp, "typedef struct tag%s_PINDEF {\n", PREFIX );
   fprintf( fp, "  int seq;\n");
   fprintf( fp, "  int pinnum;\n");
@@ -479,6 +1082,22 @@ void print_pindef_h( FILE *fp, PINDEF *pd ) {
 }
 
 void print_pindef_c( FILE *fp, PINDEF *pd ) {
+  int a1, a2, a3, sn;
+  if(opt_compact) {
+    fprintf( fp, "const %s_PINDEF %s_%s = { %d, %d, %d, %d, %d, %d, 0x%02x", 
+        PREFIX, PREFIX, pd->signame, 
+        pd->pinnum, pd->seq, pd->port, pd->bit, 
+        pd->func, pd->mode, pin_flags(pd) );
+    if(!opt_nostrings) {
+      a1=strpool_add(pd->altfunc1);
+      a2=strpool_add(pd->altfunc2);
+      a3=strpool_add(pd->altfunc3);
+      sn=strpool_add(pd->signame);
+      fprintf( fp, ", %d, %d, %d, %d", a1, a2, a3, sn );
+    }
+    fprintf( fp, " };\n");
+    return;
+  }
     fprintf( fp, "const %s_PINDEF %s_%s = { %d, %d, %d, %d, \"%s\", \"%s\", \"%s\", \"%s\", %d, %d, %d, %d, %d, %d };\n", 
         PREFIX, PREFIX, pd->signame, 
         pd->seq, pd->pinnum, pd->port, pd->bit, 
@@ -517,6 +1136,133 @@ void print_pinarray_c( FILE *fp ) {
 // Database definition:
 #define IN (1)
 #define OUT (0)
+
+// Packed per-pin flag bits, shared by the compact layouts
+#define PF_INPUT  (0x01)  // IN/OUT column is 1
+#define PF_DIRNA  (0x02)  // IN/OUT column not given
+#define PF_ODRAIN (0x04)  // open drain
+#define PF_DEF    (0x08)  // default state is 1
+#define PF_ACTIVE (0x10)  // active high
+
+int pin_flags( PINDEF *pd ) {
+  int flags=0;
+  if(pd->inout==IN)   flags |= PF_INPUT;
+  if(pd->inout==NA)   flags |= PF_DIRNA;
+  if(pd->odrain==1)   flags |= PF_ODRAIN;
+  if(pd->def==1)      flags |= PF_DEF;
+  if(pd->active==1)   flags |= PF_ACTIVE;
+  return flags;
+}
+
+void print_pinflags_h( FILE *fp ) {
+  fprintf( fp, "#define %s_PF_INPUT  (0x%02x)  // input\n", PREFIX, PF_INPUT );
+  fprintf( fp, "#define %s_PF_DIRNA  (0x%02x)  // direction not specified\n", PREFIX, PF_DIRNA );
+  fprintf( fp, "#define %s_PF_ODRAIN (0x%02x)  // open drain\n", PREFIX, PF_ODRAIN );
+  fprintf( fp, "#define %s_PF_DEF    (0x%02x)  // default state is 1\n", PREFIX, PF_DEF );
+  fprintf( fp, "#define %s_PF_ACTIVE (0x%02x)  // active high\n", PREFIX, PF_ACTIVE );
+  fprintf( fp, "\n");
+}
+
+// Returns the offset of str in the pool, adding it if not already there
+int strpool_add( char *str ) {
+  int off, len;
+  len=strlen(str);
+  for(off=0;off<strpool_len;off+=strlen(strpool+off)+1) {
+    if(0==strcmp(strpool+off,str)) return off;
+  }
+  if(strpool_len+len+1 > MAXPOOL) {
+    fprintf(stderr,"Error: string pool full\n");
+    exit(99);
+  }
+  off=strpool_len;
+  strcpy(strpool+off,str);
+  strpool_len += len+1;
+  return off;
+}
+
+//************************************************************************
+// Structure-of-arrays pin tables
+//************************************************************************
+// Parallel const arrays indexed by a generated enum, so loops over all
+// pins read only the columns they need, sequentially.
+enum { SOA_PORT, SOA_BIT, SOA_MASK, SOA_FUNC, SOA_MODE, SOA_FLAGS, SOA_PINNUM };
+
+void print_soa_h( FILE *fp ) {
+  int i;
+  char temp[MAXCHARS];
+  if(!opt_compact) print_pinflags_h( fp );
+  fprintf( fp, "typedef enum tag%s_PINID {\n", PREFIX );
+  for(i=0;i<nseqs;i++) {
+    sprintf( temp, "%s_ID_%s", PREFIX, pins[i].signame );
+    fprintf( fp, "  %-32s = %d,\n", temp, i );
+  }
+  fprintf( fp, "} %s_PINID;\n", PREFIX );
+  fprintf( fp, "\n");
+  fprintf( fp, "extern const uint8_t  %s_PORT[NUM_PINDEFS];\n", PREFIX );
+  fprintf( fp, "extern const uint8_t  %s_BIT[NUM_PINDEFS];\n", PREFIX );
+  fprintf( fp, "extern const uint32_t %s_MASK[NUM_PINDEFS];\n", PREFIX );
+  fprintf( fp, "extern const uint8_t  %s_FUNC[NUM_PINDEFS];\n", PREFIX );
+  fprintf( fp, "extern const uint8_t  %s_MODE[NUM_PINDEFS];\n", PREFIX );
+  fprintf( fp, "extern const uint8_t  %s_FLAGS[NUM_PINDEFS];\n", PREFIX );
+  fprintf( fp, "extern const uint16_t %s_PINNUM[NUM_PINDEFS];\n", PREFIX );
+  fprintf( fp, "\n");
+}
+
+void print_soa_array_c( FILE *fp, char *type, char *name, int which ) {
+  int i, ncol;
+  char temp[MAXCHARS];
+  fprintf( fp, "const %s %s_%s[NUM_PINDEFS] = {\n", type, PREFIX, name );
+  fprintf( fp, "    ");
+  ncol=4;
+  for(i=0;i<nseqs;i++) {
+    switch(which) {
+      case SOA_PORT:   sprintf( temp, "%d, ", pins[i].port ); break;
+      case SOA_BIT:    sprintf( temp, "%d, ", pins[i].bit ); break;
+      case SOA_MASK:   sprintf( temp, "0x%08lx, ", 1UL<<pins[i].bit ); break;
+      case SOA_FUNC:   sprintf( temp, "%d, ", pins[i].func ); break;
+      case SOA_MODE:   sprintf( temp, "%d, ", pins[i].mode ); break;
+      case SOA_FLAGS:  sprintf( temp, "0x%02x, ", pin_flags(&pins[i]) ); break;
+      case SOA_PINNUM: sprintf( temp, "%d, ", pins[i].pinnum ); break;
+    }
+    fprintf( fp, "%s", temp );
+    ncol += strlen(temp);
+    if(ncol > 80) {
+      fprintf( fp, "\n    ");
+      ncol=4;
+    }
+  }
+  fprintf( fp, "\n};\n");
+}
+
+void print_soa_c( FILE *fp ) {
+  fprintf( fp, "\n");
+  print_soa_array_c( fp, "uint8_t",  "PORT",   SOA_PORT );
+  print_soa_array_c( fp, "uint8_t",  "BIT",    SOA_BIT );
+  print_soa_array_c( fp, "uint32_t", "MASK",   SOA_MASK );
+  print_soa_array_c( fp, "uint8_t",  "FUNC",   SOA_FUNC );
+  print_soa_array_c( fp, "uint8_t",  "MODE",   SOA_MODE );
+  print_soa_array_c( fp, "uint8_t",  "FLAGS",  SOA_FLAGS );
+  print_soa_array_c( fp, "uint16_t", "PINNUM", SOA_PINNUM );
+}
+
+void print_strpool_c( FILE *fp ) {
+  int off, ncol, len;
+  // +1 for the literal's own terminating NUL, which C++ also requires room for
+  fprintf( fp, "const char %s_STRPOOL[%d] =\n", PREFIX, strpool_len+1 );
+  fprintf( fp, "    \"");
+  ncol=5;
+  for(off=0;off<strpool_len;off+=len+1) {
+    len=strlen(strpool+off);
+    fprintf( fp, "%s\\000", strpool+off ); // 3 digits, so a following digit can't extend the escape
+    ncol += len+4;
+    if(ncol > 80) {
+      fprintf( fp, "\"\n    \"");
+      ncol=5;
+    }
+  }
+  fprintf( fp, "\";\n");
+  fprintf( stderr, "String pool: %d bytes\n", strpool_len );
+}
 // note: FIODIR bit is 0 for input, 1 for output
 void calc_FIODIR( void ) {
   int i;
@@ -525,8 +1271,8 @@ void calc_FIODIR( void ) {
     bit = pins[i].bit;
     port = pins[i].port;
     inout = pins[i].inout;
-    if(inout==IN)  FIODIR[port] &= ~(1<<bit);
-    if(inout==OUT) FIODIR[port] |=  (1<<bit);
+    if(inout==IN)  FIODIR[port] &= ~(1UL<<bit);
+    if(inout==OUT) FIODIR[port] |=  (1UL<<bit);
   }
 }
 
@@ -546,6 +1292,7 @@ void calc_PINSEL( void ) {
     bit = pins[i].bit;
     port = pins[i].port;
     func = pins[i].func;
+    if(func==NA) continue; // not specified, leave at reset value (GPIO)
     if(bit<16) {
       reg = port*2;
       bit2 = 2*bit;
@@ -553,8 +1300,8 @@ void calc_PINSEL( void ) {
       reg = 1 + port*2;
       bit2= 2*(bit-16);
     }
-    PINSEL[reg] &= ~(0x03 << bit2); // zero the pair of bits
-    PINSEL[reg] |= (func << bit2); // or-in the desired bits field
+    PINSEL[reg] &= ~(0x03UL << bit2); // zero the pair of bits
+    PINSEL[reg] |= ((unsigned long)func << bit2); // or-in the desired bits field
   }
 }
 
@@ -583,10 +1330,10 @@ void calc_PINMODE( void ) {
       reg = 1 + port*2;
       bit2= 2*(bit-16);
     }
-    PINMODE[reg] &= ~(0x03 << bit2); // zero the pair of bits
-    PINMODE[reg] |= (mode << bit2); // or-in the desired bits field
-    if(odrain==1) PINMODE_OD[port] |=  (1<<bit);
-    if(odrain==0) PINMODE_OD[port] &= ~(1<<bit);
+    PINMODE[reg] &= ~(0x03UL << bit2); // zero the pair of bits
+    PINMODE[reg] |= ((unsigned long)mode << bit2); // or-in the desired bits field
+    if(odrain==1) PINMODE_OD[port] |=  (1UL<<bit);
+    if(odrain==0) PINMODE_OD[port] &= ~(1UL<<bit);
   }
 }
 
@@ -610,8 +1357,8 @@ void calc_FIOPIN( void ) {
     bit = pins[i].bit;
     port = pins[i].port;
     def  = pins[i].def;
-    if(def==0)  FIOPIN[port] &= ~(1<<bit);
-    if(def==1)  FIOPIN[port] |=  (1<<bit);
+    if(def==0)  FIOPIN[port] &= ~(1UL<<bit);
+    if(def==1)  FIOPIN[port] |=  (1UL<<bit);
   }
 }
 
@@ -635,7 +1382,7 @@ void calc_FIOMASK( void ) {
     bit = pins[i].bit;
     port = pins[i].port;
     func  = pins[i].func;
-    if(func==0)  FIOMASK[port] &= ~(1<<bit);
+    if(func==0)  FIOMASK[port] &= ~(1UL<<bit);
   }
 }
 
@@ -647,41 +1394,537 @@ void print_FIOMASK( FILE *fp ) {
   fprintf( fp, "\n");
 }
 
+//************************************************************************
+// Peripheral power (PCONP)
+//************************************************************************
+// The selected function name of every pin is looked up in a table of
+// LPC17xx pin functions to find the peripheral behind it.  A key ending
+// in '.' or '_' matches any name starting with it, others must match
+// exactly.  ZEBRA_PCONP_INIT powers exactly the peripherals the pinout
+// routes somewhere, plus GPIO if any pin is GPIO.  Peripherals without
+// pins (RTC, RIT, GPDMA, DAC clocking...) are up to the firmware.
+typedef struct tagPCONPDEF {
+  char *key;
+  int bit;
+  char *periph;
+} PCONPDEF;
+
+PCONPDEF pconp_table[] = {
+  { "MAT0.", 1, "TIM0" },  { "CAP0.", 1, "TIM0" },
+  { "MAT1.", 2, "TIM1" },  { "CAP1.", 2, "TIM1" },
+  { "TXD0", 3, "UART0" },  { "RXD0", 3, "UART0" },
+  { "TXD1", 4, "UART1" },  { "RXD1", 4, "UART1" },  { "CTS1", 4, "UART1" },
+  { "DCD1", 4, "UART1" },  { "DSR1", 4, "UART1" },  { "DTR1", 4, "UART1" },
+  { "RI1", 4, "UART1" },   { "RTS1", 4, "UART1" },
+  { "PWM1.", 6, "PWM1" },  { "PCAP1.", 6, "PWM1" },
+  { "SDA0", 7, "I2C0" },   { "SCL0", 7, "I2C0" },
+  { "SCK", 8, "SPI" },     { "SSEL", 8, "SPI" },    { "MISO", 8, "SPI" },   { "MOSI", 8, "SPI" },
+  { "SCK1", 10, "SSP1" },  { "SSEL1", 10, "SSP1" }, { "MISO1", 10, "SSP1" }, { "MOSI1", 10, "SSP1" },
+  { "AD0.", 12, "ADC" },
+  { "RD1", 13, "CAN1" },   { "TD1", 13, "CAN1" },
+  { "RD2", 14, "CAN2" },   { "TD2", 14, "CAN2" },
+  { "MCOA0", 17, "MCPWM" }, { "MCOA1", 17, "MCPWM" }, { "MCOA2", 17, "MCPWM" },
+  { "MCOB0", 17, "MCPWM" }, { "MCOB1", 17, "MCPWM" }, { "MCOB2", 17, "MCPWM" },
+  { "MCI0", 17, "MCPWM" },  { "MCI1", 17, "MCPWM" },  { "MCI2", 17, "MCPWM" },
+  { "MCABORT", 17, "MCPWM" },
+  { "PHA", 18, "QEI" },    { "PHB", 18, "QEI" },    { "IDX", 18, "QEI" },
+  { "SDA1", 19, "I2C1" },  { "SCL1", 19, "I2C1" },
+  { "SCK0", 21, "SSP0" },  { "SSEL0", 21, "SSP0" }, { "MISO0", 21, "SSP0" }, { "MOSI0", 21, "SSP0" },
+  { "MAT2.", 22, "TIM2" }, { "CAP2.", 22, "TIM2" },
+  { "MAT3.", 23, "TIM3" }, { "CAP3.", 23, "TIM3" },
+  { "TXD2", 24, "UART2" }, { "RXD2", 24, "UART2" },
+  { "TXD3", 25, "UART3" }, { "RXD3", 25, "UART3" },
+  { "SDA2", 26, "I2C2" },  { "SCL2", 26, "I2C2" },
+  { "I2SRX_", 27, "I2S" }, { "I2STX_", 27, "I2S" }, { "RX_MCLK", 27, "I2S" }, { "TX_MCLK", 27, "I2S" },
+  { "ENET_", 30, "ENET" },
+  { "USB_", 31, "USB" },   { "VBUS", 31, "USB" },
+  { NULL, 0, NULL }
+};
+#define PCONP_GPIO  (15)
+#define PCONP_RESET (0x042887deUL)  // UM10360 reset value
+
+unsigned long PCONP;         // peripherals the pinout routes
+unsigned long PCONP_KNOWN;   // peripherals that have pins at all
+
+// name of the function the FUNC column selects, "" for none
+const char *pin_function_name( PINDEF *pd ) {
+  if(pd->func==1) return pd->altfunc1;
+  if(pd->func==2) return pd->altfunc2;
+  if(pd->func==3) return pd->altfunc3;
+  return "";
+}
+
+int pconp_lookup( const char *name ) {
+  PCONPDEF *pt;
+  int len;
+  for(pt=pconp_table;pt->key;pt++) {
+    len=strlen(pt->key);
+    if((pt->key[len-1]=='.') || (pt->key[len-1]=='_')) {
+      if(0==strncmp(name,pt->key,len)) return pt->bit;
+    } else {
+      if(0==strcmp(name,pt->key)) return pt->bit;
+    }
+  }
+  return -1;
+}
+
+const char *pconp_periph( int bit ) {
+  PCONPDEF *pt;
+  if(bit==PCONP_GPIO) return "GPIO";
+  for(pt=pconp_table;pt->key;pt++) {
+    if(pt->bit==bit) return pt->periph;
+  }
+  return "?";
+}
+
+void calc_PCONP( void ) {
+  int i, bit;
+  PCONPDEF *pt;
+  PCONP=0;
+  PCONP_KNOWN=1UL<<PCONP_GPIO;
+  for(pt=pconp_table;pt->key;pt++) PCONP_KNOWN |= 1UL<<pt->bit;
+  for(i=0;i<nseqs;i++) {
+    if(pins[i].func==0) PCONP |= 1UL<<PCONP_GPIO;
+    if((pins[i].func<1) || (pins[i].func>3)) continue;
+    bit=pconp_lookup( pin_function_name(&pins[i]) );
+    if(bit>=0) PCONP |= 1UL<<bit;
+  }
+}
+
+void print_pconp_list( FILE *fp, unsigned long mask ) {
+  int bit;
+  for(bit=0;bit<32;bit++) {
+    if(mask & (1UL<<bit)) fprintf( fp, " %s", pconp_periph(bit) );
+  }
+}
+
+void print_PCONP( FILE *fp ) {
+  unsigned long idle;
+  fprintf( fp, "// peripherals the pinout uses:");
+  print_pconp_list( fp, PCONP );
+  fprintf( fp, "\n");
+  fprintf( fp, "#define %s_PCONP_INIT (0x%08lx)\n", PREFIX, PCONP );
+  idle = PCONP_RESET & PCONP_KNOWN & ~PCONP;
+  if(idle) {
+    fprintf( fp, "// powered at reset but routed nowhere:");
+    print_pconp_list( fp, idle );
+    fprintf( fp, "\n");
+  }
+  fprintf( fp, "\n");
+  if(opt_pconp) {
+    idle = pconp_code & PCONP_KNOWN & ~PCONP;
+    if(idle) {
+      fprintf( stderr, "Warning: PCONP 0x%08lx powers peripherals routed nowhere:", pconp_code );
+      print_pconp_list( stderr, idle );
+      fprintf( stderr, "\n");
+    }
+    idle = PCONP & ~pconp_code;
+    if(idle) {
+      fprintf( stderr, "Warning: PCONP 0x%08lx leaves routed peripherals off:", pconp_code );
+      print_pconp_list( stderr, idle );
+      fprintf( stderr, "\n");
+    }
+  }
+}
+
+
+//************************************************************************
+// ADC channels
+//************************************************************************
+// Pins whose selected function is AD0.n are channel n.  In burst mode
+// the ADC converts the SEL channels over and over in ascending channel
+// order, whatever order the pinout lists them in, so that is the order
+// a DMA stream from ADGDR delivers samples in.  ZEBRA_ADC_IDX_x gives a
+// signal's slot in that stream.
+int adc_channel( PINDEF *pd ) {
+  int ch;
+  const char *name;
+  name=pin_function_name( pd );
+  if((1==sscanf(name,"AD0.%d",&ch)) && (ch>=0) && (ch<8)) return ch;
+  return -1;
+}
+
+unsigned long adc_channel_mask( void ) {
+  int i, ch;
+  unsigned long mask=0;
+  for(i=0;i<nseqs;i++) {
+    ch=adc_channel( &pins[i] );
+    if(ch>=0) mask |= 1UL<<ch;
+  }
+  return mask;
+}
+
+void print_adc( FILE *fp ) {
+  int i, ch, n, idx;
+  unsigned long mask;
+  char temp[MAXCHARS];
+
+  mask=adc_channel_mask();
+  for(n=0,ch=0;ch<8;ch++) {
+    if(mask & (1UL<<ch)) n++;
+  }
+  fprintf( fp, "#define %s_ADC_CHANNEL_MASK (0x%02lx)\n", PREFIX, mask );
+  fprintf( fp, "#define %s_ADC_NCHANNELS    (%d)\n", PREFIX, n );
+  fprintf( fp, "// ADCR for burst mode: SEL = used channels, CLKDIV, BURST, PDN\n");
+  fprintf( fp, "#define %s_ADCR_BURST(clkdiv) (0x%02lxUL | (((clkdiv) & 0xffUL) << 8) | (1UL << 16) | (1UL << 21))\n",
+               PREFIX, mask );
+  fprintf( fp, "// channel of each burst result slot, in conversion order\n");
+  fprintf( fp, "#define %s_ADC_ORDER_INIT {", PREFIX );
+  for(idx=0,ch=0;ch<8;ch++) {
+    if(mask & (1UL<<ch)) fprintf( fp, "%s%d", idx++ ? ", " : " ", ch );
+  }
+  fprintf( fp, " }\n");
+  for(i=0;i<nseqs;i++) {
+    ch=adc_channel( &pins[i] );
+    if(ch<0) continue;
+    for(idx=0,n=0;n<ch;n++) {
+      if(mask & (1UL<<n)) idx++;
+    }
+    if(pins[i].mode!=2) {
+      fprintf(stderr,"Warning: %s: analog input with MODE %d, 2 (no pull-up/down) is usual\n",
+                       pins[i].signame, pins[i].mode );
+    }
+    sprintf( temp, "%s_ADC_CH_%s", PREFIX, pins[i].signame );
+    fprintf( fp, "#define %-36s (%d)\n", temp, ch );
+    sprintf( temp, "%s_ADC_IDX_%s", PREFIX, pins[i].signame );
+    fprintf( fp, "#define %-36s (%d)\n", temp, idx );
+    sprintf( temp, "%s_ADC_RESULT_%s()", PREFIX, pins[i].signame );
+    fprintf( fp, "#define %-36s ((LPC_ADC->ADDR%d >> 4) & 0xfff)\n", temp, ch );
+  }
+  fprintf( fp, "\n");
+}
+
+
+//************************************************************************
+// PWM and timer channels
+//************************************************************************
+// PWM1.n pins give the PWM1 channels in use: their PCR output enables
+// (PWMENAn, bit 8+n) and LER latch bits (bit n, for MRn).  New duty
+// cycles written to MRn only take effect at the next period once their
+// LER bit is set, so writing every MR and then LER once changes all
+// channels on the same period boundary.  MATn.m and CAPn.m pins give
+// the EMR, MCR and CCR bits of the four general-purpose timers.
+
+// channel of the selected function if it matches fmt, e.g. "MAT%d.%d"
+// (timer, channel) or "PWM1.%d" (channel only, timer set to 1)
+int timer_channel( PINDEF *pd, const char *fmt, int *timer ) {
+  int t, ch;
+  const char *name;
+  name=pin_function_name( pd );
+  if(0==strncmp(fmt,"PWM1.",5) || 0==strncmp(fmt,"PCAP1.",6)) {
+    *timer=1;
+    if(1==sscanf(name,fmt,&ch)) return ch;
+    return -1;
+  }
+  if(2==sscanf(name,fmt,&t,&ch) && (t>=0) && (t<4)) {
+    *timer=t;
+    return ch;
+  }
+  return -1;
+}
+
+unsigned long pwm_channel_mask( void ) {
+  int i, t, ch;
+  unsigned long mask=0;
+  for(i=0;i<nseqs;i++) {
+    ch=timer_channel( &pins[i], "PWM1.%d", &t );
+    if((ch>=1) && (ch<=6)) mask |= 1UL<<ch;
+  }
+  return mask;
+}
+
+bool any_timer_pin( void ) {
+  int i, t;
+  for(i=0;i<nseqs;i++) {
+    if(timer_channel( &pins[i], "MAT%d.%d", &t )>=0) return true;
+    if(timer_channel( &pins[i], "CAP%d.%d", &t )>=0) return true;
+  }
+  return false;
+}
+
+void print_pwm_h( FILE *fp ) {
+  int i, t, ch, n, idx;
+  unsigned long mask, capmask=0;
+  char temp[MAXCHARS];
+
+  mask=pwm_channel_mask();
+  for(i=0;i<nseqs;i++) {
+    ch=timer_channel( &pins[i], "PCAP1.%d", &t );
+    if((ch==0) || (ch==1)) capmask |= 1UL<<ch;
+  }
+  for(n=0,ch=1;ch<=6;ch++) {
+    if(mask & (1UL<<ch)) n++;
+  }
+  fprintf( fp, "#define %s_PWM_CHANNEL_MASK (0x%02lx)  // bit n = PWM1.n\n", PREFIX, mask );
+  fprintf( fp, "#define %s_PWM_NCHANNELS    (%d)\n", PREFIX, n );
+  fprintf( fp, "#define %s_PWM1PCR_INIT     (0x%08lx)  // PWMENAn, single edge\n", PREFIX, mask<<8 );
+  fprintf( fp, "#define %s_PWM_LER_ALL      (0x%02lx)  // LERn of every used channel\n", PREFIX, mask );
+  fprintf( fp, "#define %s_PWM_LER_PERIOD   (0x01)  // LER0, for MR0\n", PREFIX );
+  if(capmask) {
+    fprintf( fp, "#define %s_PWM_CAP_MASK     (0x%02lx)  // bit n = PCAP1.n\n", PREFIX, capmask );
+    fprintf( fp, "#define %s_PWM1CCR_BOTH     (0x%08lx)  // both edges and interrupt\n", PREFIX,
+                 ((capmask&1) ? 0x07UL : 0) | ((capmask&2) ? 0x38UL : 0) );
+  }
+  for(i=0;i<nseqs;i++) {
+    ch=timer_channel( &pins[i], "PWM1.%d", &t );
+    if((ch<1) || (ch>6)) continue;
+    for(idx=0,n=1;n<ch;n++) {
+      if(mask & (1UL<<n)) idx++;
+    }
+    sprintf( temp, "%s_PWM_CH_%s", PREFIX, pins[i].signame );
+    fprintf( fp, "#define %-36s (%d)\n", temp, ch );
+    sprintf( temp, "%s_PWM_IDX_%s", PREFIX, pins[i].signame );
+    fprintf( fp, "#define %-36s (%d)  // slot in %s_gpio_pwm_update()\n", temp, idx, prefix );
+    sprintf( temp, "%s_PWM_SET_%s(v)", PREFIX, pins[i].signame );
+    fprintf( fp, "#define %-36s (LPC_PWM1->MR%d = (v))\n", temp, ch );
+  }
+  fprintf( fp, "extern void %s_gpio_pwm_update( const uint32_t duty[%s_PWM_NCHANNELS] );\n", prefix, PREFIX );
+  fprintf( fp, "\n");
+}
+
+// all duty cycles, then one LER store, so every channel switches on the
+// same PWM period boundary
+void print_pwm_c( FILE *fp ) {
+  int ch, idx;
+  unsigned long mask;
+  mask=pwm_channel_mask();
+  fprintf( fp, "\n");
+  fprintf( fp, "void %s_gpio_pwm_update( const uint32_t duty[%s_PWM_NCHANNELS] ) {\n", prefix, PREFIX );
+  for(idx=0,ch=1;ch<=6;ch++) {
+    if(mask & (1UL<<ch)) fprintf( fp, "  LPC_PWM1->MR%d = duty[%d];\n", ch, idx++ );
+  }
+  fprintf( fp, "  LPC_PWM1->LER = %s_PWM_LER_ALL;\n", PREFIX );
+  fprintf( fp, "}\n");
+}
+
+void print_timer_h( FILE *fp ) {
+  int i, t, ch;
+  unsigned long mat[4], cap[4], emr, mcr, ccr;
+  char temp[MAXCHARS];
+
+  for(t=0;t<4;t++) mat[t]=cap[t]=0;
+  for(i=0;i<nseqs;i++) {
+    ch=timer_channel( &pins[i], "MAT%d.%d", &t );
+    if((ch>=0) && (ch<4)) mat[t] |= 1UL<<ch;
+    ch=timer_channel( &pins[i], "CAP%d.%d", &t );
+    if((ch>=0) && (ch<2)) cap[t] |= 1UL<<ch;
+  }
+  for(t=0;t<4;t++) {
+    if(!mat[t] && !cap[t]) continue;
+    emr=mcr=ccr=0;
+    for(ch=0;ch<4;ch++) {
+      if(mat[t] & (1UL<<ch)) {
+        emr |= 0x03UL<<(4+2*ch);  // EMCn = toggle
+        mcr |= 0x01UL<<(3*ch);    // MRnI
+      }
+    }
+    for(ch=0;ch<2;ch++) {
+      if(cap[t] & (1UL<<ch)) ccr |= 0x07UL<<(3*ch);  // rising, falling, interrupt
+    }
+    if(mat[t]) {
+      sprintf( temp, "%s_TIM%d_MAT_MASK", PREFIX, t );
+      fprintf( fp, "#define %-32s (0x%02lx)  // bit n = MAT%d.n\n", temp, mat[t], t );
+      sprintf( temp, "%s_TIM%d_EMR_TOGGLE", PREFIX, t );
+      fprintf( fp, "#define %-32s (0x%08lx)\n", temp, emr );
+      sprintf( temp, "%s_TIM%d_MCR_INT", PREFIX, t );
+      fprintf( fp, "#define %-32s (0x%08lx)\n", temp, mcr );
+    }
+    if(cap[t]) {
+      sprintf( temp, "%s_TIM%d_CAP_MASK", PREFIX, t );
+      fprintf( fp, "#define %-32s (0x%02lx)  // bit n = CAP%d.n\n", temp, cap[t], t );
+      sprintf( temp, "%s_TIM%d_CCR_BOTH", PREFIX, t );
+      fprintf( fp, "#define %-32s (0x%08lx)\n", temp, ccr );
+    }
+  }
+  fprintf( fp, "\n");
+}
+
 
 // consider output, open-drain
 
 
+//************************************************************************
+// Block-copy PINCON initialization
+//************************************************************************
+// PINSEL0..10 are contiguous at the start of the PINCON block, and
+// PINMODE0..9 are immediately followed by PINMODE_OD0..4, so each bank
+// can be written from a const image with LDM/STM bursts instead of one
+// literal load and store per register.
+#define PINSEL_NREGS (11)
+#define PINMODE_NREGS (15)  // PINMODE0..9 plus PINMODE_OD0..4
+#define LDM_NREGS (4)       // registers moved per LDM/STM burst
+
+unsigned long pinmode_image( int i ) {
+  if(i<10) return PINMODE[i];
+  return PINMODE_OD[i-10];
+}
+
+void print_blockinit_h( FILE *fp ) {
+  fprintf( fp, "#define %s_PINSEL_NREGS (%d)\n", PREFIX, PINSEL_NREGS );
+  fprintf( fp, "#define %s_PINMODE_NREGS (%d)\n", PREFIX, PINMODE_NREGS );
+  fprintf( fp, "extern const uint32_t %s_PINSEL_IMAGE[%s_PINSEL_NREGS];\n", PREFIX, PREFIX );
+  fprintf( fp, "extern const uint32_t %s_PINMODE_IMAGE[%s_PINMODE_NREGS];\n", PREFIX, PREFIX );
+  fprintf( fp, "extern void %s_gpio_init_pincon( void );\n", prefix );
+  fprintf( fp, "\n");
+}
+
+void print_ldm_bursts( FILE *fp, int nregs ) {
+  int n;
+  for(n=nregs;n>0;n-=LDM_NREGS) {
+    if(n>=LDM_NREGS) {
+      fprintf( fp, "    \"ldmia %%0!, {r2-r5}\\n\\t\"\n");
+      fprintf( fp, "    \"stmia %%1!, {r2-r5}\\n\\t\"\n");
+    } else {
+      fprintf( fp, "    \"ldmia %%0!, {r2-r%d}\\n\\t\"\n", n+1 );
+      fprintf( fp, "    \"stmia %%1!, {r2-r%d}\\n\\t\"\n", n+1 );
+    }
+  }
+}
+
+void print_blockinit_c( FILE *fp ) {
+  int i;
+  fprintf( fp, "\n");
+  fprintf( fp, "// PINSEL0..10\n");
+  fprintf( fp, "const uint32_t %s_PINSEL_IMAGE[%s_PINSEL_NREGS] = {\n", PREFIX, PREFIX );
+  for(i=0;i<PINSEL_NREGS;i++) {
+    fprintf( fp, "    0x%08lx,\n", PINSEL[i] );
+  }
+  fprintf( fp, "};\n");
+  fprintf( fp, "\n");
+  fprintf( fp, "// PINMODE0..9, PINMODE_OD0..4\n");
+  fprintf( fp, "const uint32_t %s_PINMODE_IMAGE[%s_PINMODE_NREGS] = {\n", PREFIX, PREFIX );
+  for(i=0;i<PINMODE_NREGS;i++) {
+    fprintf( fp, "    0x%08lx,\n", pinmode_image(i) );
+  }
+  fprintf( fp, "};\n");
+  fprintf( fp, "\n");
+  fprintf( fp, "void %s_gpio_init_pincon( void ) {\n", prefix );
+  fprintf( fp, "#if defined(__GNUC__) && defined(__thumb2__)\n");
+  fprintf( fp, "  const uint32_t *src;\n");
+  fprintf( fp, "  volatile uint32_t *dst;\n");
+  fprintf( fp, "  src = %s_PINSEL_IMAGE;\n", PREFIX );
+  fprintf( fp, "  dst = &LPC_PINCON->PINSEL0;\n");
+  fprintf( fp, "  __asm volatile (\n");
+  print_ldm_bursts( fp, PINSEL_NREGS );
+  fprintf( fp, "    : \"+r\" (src), \"+r\" (dst) : : \"r2\", \"r3\", \"r4\", \"r5\", \"memory\" );\n");
+  fprintf( fp, "  src = %s_PINMODE_IMAGE;\n", PREFIX );
+  fprintf( fp, "  dst = &LPC_PINCON->PINMODE0;\n");
+  fprintf( fp, "  __asm volatile (\n");
+  print_ldm_bursts( fp, PINMODE_NREGS );
+  fprintf( fp, "    : \"+r\" (src), \"+r\" (dst) : : \"r2\", \"r3\", \"r4\", \"r5\", \"memory\" );\n");
+  fprintf( fp, "#else\n");
+  fprintf( fp, "  int i;\n");
+  fprintf( fp, "  for(i=0;i<%s_PINSEL_NREGS;i++) (&LPC_PINCON->PINSEL0)[i] = %s_PINSEL_IMAGE[i];\n", PREFIX, PREFIX );
+  fprintf( fp, "  for(i=0;i<%s_PINMODE_NREGS;i++) (&LPC_PINCON->PINMODE0)[i] = %s_PINMODE_IMAGE[i];\n", PREFIX, PREFIX );
+  fprintf( fp, "#endif\n");
+  fprintf( fp, "}\n");
+}
+
+// Thumb-2 size of loading a constant and storing it to a register
+// at a small offset from a base already held in a register.
+int store_cost( unsigned long val, bool *have_zero ) {
+  if(val==0) {
+    if(*have_zero) return 2;   // STR from the zero register
+    *have_zero=true;
+    return 4;                  // MOVS + STR
+  }
+  if(val<256) return 4;        // MOVS + STR
+  return 8;                    // LDR literal + 4-byte pool entry + STR
+}
+
+// Rough flash cost estimate, printed to stderr and into the header so
+// the two variants can be compared for a given pinout.
+void print_blockinit_cost( FILE *fp ) {
+  int i, c, nbursts;
+  int bytes_store, bytes_block;
+  int insns_store, insns_block;
+  bool have_zero;
+
+  // store-per-register: one base address literal, then a store per register
+  have_zero=false;
+  bytes_store = 6 + 2; // LDR base + pool entry, BX LR
+  insns_store = 2;
+  for(i=0;i<PINSEL_NREGS+PINMODE_NREGS;i++) {
+    if(i<PINSEL_NREGS) c = store_cost( PINSEL[i], &have_zero );
+    else               c = store_cost( pinmode_image(i-PINSEL_NREGS), &have_zero );
+    bytes_store += c;
+    insns_store += (c==2) ? 1 : 2;
+  }
+
+  // block copy: both images, two src/dst literal pairs, PUSH/POP of r4-r5,
+  // and a 16-bit LDMIA/STMIA pair per burst
+  nbursts = (PINSEL_NREGS+LDM_NREGS-1)/LDM_NREGS + (PINMODE_NREGS+LDM_NREGS-1)/LDM_NREGS;
+  bytes_block = 4*(PINSEL_NREGS+PINMODE_NREGS) + 2*(6+6) + 2 + 2 + 4*nbursts;
+  insns_block = 4 + 2 + 2*nbursts;
+
+  fprintf( fp, "// PINCON init flash estimate (Thumb-2, %d registers):\n", PINSEL_NREGS+PINMODE_NREGS );
+  fprintf( fp, "//   store-per-register: %4d bytes, %3d instructions\n", bytes_store, insns_store );
+  fprintf( fp, "//   block-copy image:   %4d bytes, %3d instructions (%d LDM/STM bursts)\n",
+                     bytes_block, insns_block, nbursts );
+  fprintf( fp, "\n");
+  fprintf( stderr, "PINCON init: store-per-register %d bytes/%d insns, block-copy %d bytes/%d insns\n",
+                     bytes_store, insns_store, bytes_block, insns_block );
+}
+
+
+// The store behind a SET/CLR/ON/OFF/OPEN/SINK macro, a write of the
+// pin's bit to FIOSET (level 1) or FIOCLR (level 0).  With -trace it is
+// wrapped so a PREFIX_TRACE build also logs it; otherwise unchanged.
+char *pin_store( char *out, int i, int level ) {
+  char st[MAXCHARS];
+  sprintf( st, "LPC_GPIO%d->%s = (1<<%d)", pins[i].port, level ? "FIOSET" : "FIOCLR", pins[i].bit );
+  if(opt_trace) sprintf( out, "%s_TRACED( %d, %d, %s )", PREFIX, i, level, st );
+  else          sprintf( out, "(%s)", st );
+  return out;
+}
+
 void print_bit_macros( FILE *fp ) {
   int i;
+  char st[MAXCHARS];
   for(i=0;i<nseqs;i++) {
 
-    fprintf( fp, "#define %s_GET_%-25s   ((LPC_GPIO%d->FIOPIN & (1<<%d)) >> %d)\n", 
-                        PREFIX, pins[i].signame, pins[i].port, pins[i].bit, pins[i].bit );
+    if(opt_bitband) {
+      fprintf( fp, "#define %s_GET_%-25s   (%s_BB_PIN_%s)\n", 
+                          PREFIX, pins[i].signame, PREFIX, pins[i].signame );
+    } else {
+      fprintf( fp, "#define %s_GET_%-25s   ((LPC_GPIO%d->FIOPIN & (1<<%d)) >> %d)\n", 
+                          PREFIX, pins[i].signame, pins[i].port, pins[i].bit, pins[i].bit );
+    }
 
     if(pins[i].odrain==1) {  // open drain
-      fprintf( fp, "#define %s_OPEN_%-25s    (LPC_GPIO%d->FIOSET = (1<<%d))\n", 
-                          PREFIX, pins[i].signame, pins[i].port, pins[i].bit );
-      fprintf( fp, "#define %s_SINK_%-25s    (LPC_GPIO%d->FIOCLR = (1<<%d))\n", 
-                          PREFIX, pins[i].signame, pins[i].port, pins[i].bit );
+      fprintf( fp, "#define %s_OPEN_%-25s    %s\n", 
+                          PREFIX, pins[i].signame, pin_store( st, i, 1 ) );
+      fprintf( fp, "#define %s_SINK_%-25s    %s\n", 
+                          PREFIX, pins[i].signame, pin_store( st, i, 0 ) );
     } else { // driven output
-      fprintf( fp, "#define %s_SET_%-25s    (LPC_GPIO%d->FIOSET = (1<<%d))\n", 
-                          PREFIX, pins[i].signame, pins[i].port, pins[i].bit );
-      fprintf( fp, "#define %s_CLR_%-25s    (LPC_GPIO%d->FIOCLR = (1<<%d))\n", 
-                          PREFIX, pins[i].signame, pins[i].port, pins[i].bit );
+      fprintf( fp, "#define %s_SET_%-25s    %s\n", 
+                          PREFIX, pins[i].signame, pin_store( st, i, 1 ) );
+      fprintf( fp, "#define %s_CLR_%-25s    %s\n", 
+                          PREFIX, pins[i].signame, pin_store( st, i, 0 ) );
       if(pins[i].active==1) { // active high
-        fprintf( fp, "#define %s_ON_%-25s    (LPC_GPIO%d->FIOSET = (1<<%d))\n", 
-                            PREFIX, pins[i].signame, pins[i].port, pins[i].bit );
-        fprintf( fp, "#define %s_OFF_%-25s    (LPC_GPIO%d->FIOCLR = (1<<%d))\n", 
-                            PREFIX, pins[i].signame, pins[i].port, pins[i].bit );
-        fprintf( fp, "#define %s_QON_%-25s   ((LPC_GPIO%d->FIOPIN & (1<<%d)) >> %d)\n", 
-                            PREFIX, pins[i].signame, pins[i].port, pins[i].bit, pins[i].bit );
+        fprintf( fp, "#define %s_ON_%-25s    %s\n", 
+                            PREFIX, pins[i].signame, pin_store( st, i, 1 ) );
+        fprintf( fp, "#define %s_OFF_%-25s    %s\n", 
+                            PREFIX, pins[i].signame, pin_store( st, i, 0 ) );
+        if(opt_bitband) {
+          fprintf( fp, "#define %s_QON_%-25s   (%s_BB_PIN_%s)\n", 
+                              PREFIX, pins[i].signame, PREFIX, pins[i].signame );
+        } else {
+          fprintf( fp, "#define %s_QON_%-25s   ((LPC_GPIO%d->FIOPIN & (1<<%d)) >> %d)\n", 
+                              PREFIX, pins[i].signame, pins[i].port, pins[i].bit, pins[i].bit );
+        }
       } else if(pins[i].active==0) { // active low
-        fprintf( fp, "#define %s_ON_%-25s     (LPC_GPIO%d->FIOCLR = (1<<%d))\n", 
-                            PREFIX, pins[i].signame, pins[i].port, pins[i].bit );
-        fprintf( fp, "#define %s_OFF_%-25s    (LPC_GPIO%d->FIOSET = (1<<%d))\n", 
-                            PREFIX, pins[i].signame, pins[i].port, pins[i].bit );
-        fprintf( fp, "#define %s_QON_%-25s  (((LPC_GPIO%d->FIOPIN & (1<<%d)) >> %d)^1)\n", 
-                            PREFIX, pins[i].signame, pins[i].port, pins[i].bit, pins[i].bit );
+        fprintf( fp, "#define %s_ON_%-25s     %s\n", 
+                            PREFIX, pins[i].signame, pin_store( st, i, 0 ) );
+        fprintf( fp, "#define %s_OFF_%-25s    %s\n", 
+                            PREFIX, pins[i].signame, pin_store( st, i, 1 ) );
+        if(opt_bitband) {
+          fprintf( fp, "#define %s_QON_%-25s  (%s_BB_PIN_%s^1)\n", 
+                              PREFIX, pins[i].signame, PREFIX, pins[i].signame );
+        } else {
+          fprintf( fp, "#define %s_QON_%-25s  (((LPC_GPIO%d->FIOPIN & (1<<%d)) >> %d)^1)\n", 
+                              PREFIX, pins[i].signame, pins[i].port, pins[i].bit, pins[i].bit );
+        }
       }
     }
   }
@@ -702,6 +1945,3159 @@ void print_bit_defines( FILE *fp ) {
 }
 
 
+//************************************************************************
+// GPIO trace hooks
+//************************************************************************
+// With -trace every SET/CLR/ON/OFF/OPEN/SINK macro goes through
+// PREFIX_TRACED().  Built without PREFIX_TRACE that is just the store;
+// with it, an inline hook first logs (time, pin index, level) into a RAM
+// ring buffer and counts the pin's level changes, for field units that
+// can't run a debug build.  The buffer has one writer and no locks: the
+// head is published after the entry, and the reader drops anything the
+// writer laps.
+
+// PREFIX_TRACE and friends share the PREFIX_<signal> namespace
+void check_trace_names( void ) {
+  int i, j;
+  const char *names[] = { "TRACE", "TRACED", "TRACE_DEPTH", "TRACE_TIME", "TRACE_CYCCNT", "TRACE_ENTRY" };
+  for(i=0;i<nseqs;i++) {
+    for(j=0;j<6;j++) {
+      if(0==strcmp(pins[i].signame,names[j])) {
+        fprintf(stderr,"Error: signal %s clashes with %s_%s used by -trace\n", pins[i].signame, PREFIX, names[j] );
+        exit(99);
+      }
+    }
+  }
+}
+
+void print_trace_h( FILE *fp ) {
+  char temp[MAXCHARS];
+  fprintf( fp, "// Build with %s_TRACE defined and the pin macros below log each write\n", PREFIX );
+  fprintf( fp, "// to %s_gpio_trace_buf[] and count level changes per pin; otherwise\n", prefix );
+  fprintf( fp, "// they are the plain stores.  Only one context (main loop or one ISR)\n");
+  fprintf( fp, "// may use the macros, since the log has a single writer.\n");
+  fprintf( fp, "#ifdef %s_TRACE\n", PREFIX );
+  fprintf( fp, "#ifndef %s_TRACE_DEPTH\n", PREFIX );
+  sprintf( temp, "%s_TRACE_DEPTH", PREFIX );
+  fprintf( fp, "#define %-32s    (256)   // entries, a power of two\n", temp );
+  fprintf( fp, "#endif\n");
+  fprintf( fp, "#if (%s_TRACE_DEPTH & (%s_TRACE_DEPTH-1))\n", PREFIX, PREFIX );
+  fprintf( fp, "#error %s_TRACE_DEPTH must be a power of two\n", PREFIX );
+  fprintf( fp, "#endif\n");
+  fprintf( fp, "#ifndef %s_TRACE_TIME\n", PREFIX );
+  fprintf( fp, "#define %s_TRACE_CYCCNT                 // DWT cycle counter, started by %s_gpio_trace_init()\n", PREFIX, prefix );
+  sprintf( temp, "%s_TRACE_TIME()", PREFIX );
+  fprintf( fp, "#define %-32s    (*(volatile uint32_t *)0xE0001004)\n", temp );
+  fprintf( fp, "#endif\n");
+  fprintf( fp, "\n");
+  fprintf( fp, "typedef struct tag%s_TRACE_ENTRY {\n", PREFIX );
+  fprintf( fp, "  uint32_t time;\n");
+  fprintf( fp, "  uint16_t pin;     // index into %s_PINS[]\n", PREFIX );
+  fprintf( fp, "  uint16_t level;   // 1 written to FIOSET, 0 to FIOCLR\n");
+  fprintf( fp, "} %s_TRACE_ENTRY;\n", PREFIX );
+  fprintf( fp, "\n");
+  fprintf( fp, "extern volatile %s_TRACE_ENTRY %s_gpio_trace_buf[%s_TRACE_DEPTH];\n", PREFIX, prefix, PREFIX );
+  fprintf( fp, "extern volatile uint32_t %s_gpio_trace_head;   // entries ever logged\n", prefix );
+  fprintf( fp, "extern uint32_t %s_gpio_trace_toggles[NUM_PINDEFS];\n", prefix );
+  fprintf( fp, "extern uint8_t %s_gpio_trace_level[NUM_PINDEFS];\n", prefix );
+  fprintf( fp, "void %s_gpio_trace_init( void );\n", prefix );
+  fprintf( fp, "uint32_t %s_gpio_trace_read( uint32_t *tail, %s_TRACE_ENTRY *out, uint32_t n );\n", prefix, PREFIX );
+  fprintf( fp, "\n");
+  fprintf( fp, "static inline void %s_gpio_trace( uint32_t pin, uint32_t level ) {\n", prefix );
+  fprintf( fp, "  uint32_t h;\n");
+  fprintf( fp, "  volatile %s_TRACE_ENTRY *e;\n", PREFIX );
+  fprintf( fp, "  h = %s_gpio_trace_head;\n", prefix );
+  fprintf( fp, "  e = &%s_gpio_trace_buf[h & (%s_TRACE_DEPTH-1)];\n", prefix, PREFIX );
+  fprintf( fp, "  e->time = %s_TRACE_TIME();\n", PREFIX );
+  fprintf( fp, "  e->pin = pin;\n");
+  fprintf( fp, "  e->level = level;\n");
+  fprintf( fp, "  %s_gpio_trace_toggles[pin] += %s_gpio_trace_level[pin] ^ level;\n", prefix, prefix );
+  fprintf( fp, "  %s_gpio_trace_level[pin] = level;\n", prefix );
+  fprintf( fp, "  %s_gpio_trace_head = h+1;   // publish after the entry\n", prefix );
+  fprintf( fp, "}\n");
+  fprintf( fp, "\n");
+  sprintf( temp, "%s_TRACED(pin,level,store)", PREFIX );
+  fprintf( fp, "#define %-32s    (%s_gpio_trace( (pin), (level) ), (store))\n", temp, prefix );
+  fprintf( fp, "#else\n");
+  fprintf( fp, "#define %-32s    (store)\n", temp );
+  fprintf( fp, "#endif\n");
+  fprintf( fp, "\n");
+}
+
+void print_trace_c( FILE *fp ) {
+  int i;
+  fprintf( fp, "#ifdef %s_TRACE\n", PREFIX );
+  fprintf( fp, "volatile %s_TRACE_ENTRY %s_gpio_trace_buf[%s_TRACE_DEPTH];\n", PREFIX, prefix, PREFIX );
+  fprintf( fp, "volatile uint32_t %s_gpio_trace_head;\n", prefix );
+  fprintf( fp, "uint32_t %s_gpio_trace_toggles[NUM_PINDEFS];\n", prefix );
+  fprintf( fp, "uint8_t %s_gpio_trace_level[NUM_PINDEFS];\n", prefix );
+  fprintf( fp, "\n");
+  fprintf( fp, "// empty the log and take each pin's starting level from FIOPIN\n");
+  fprintf( fp, "void %s_gpio_trace_init( void ) {\n", prefix );
+  fprintf( fp, "  int i;\n");
+  fprintf( fp, "#ifdef %s_TRACE_CYCCNT\n", PREFIX );
+  fprintf( fp, "  *(volatile uint32_t *)0xE000EDFC |= 1UL<<24;   // DEMCR.TRCENA\n");
+  fprintf( fp, "  *(volatile uint32_t *)0xE0001000 |= 1UL;       // DWT_CTRL.CYCCNTENA\n");
+  fprintf( fp, "#endif\n");
+  fprintf( fp, "  %s_gpio_trace_head = 0;\n", prefix );
+  fprintf( fp, "  for(i=0;i<NUM_PINDEFS;i++) %s_gpio_trace_toggles[i] = 0;\n", prefix );
+  for(i=0;i<nseqs;i++) {
+    fprintf( fp, "  %s_gpio_trace_level[%d] = (LPC_GPIO%d->FIOPIN >> %d) & 1;   // %s\n",
+                       prefix, i, pins[i].port, pins[i].bit, pins[i].signame );
+  }
+  fprintf( fp, "}\n");
+  fprintf( fp, "\n");
+  fprintf( fp, "// Copy the entries logged since *tail, oldest first, into out[] (at\n");
+  fprintf( fp, "// most n) and advance *tail; returns how many were copied.  Entries\n");
+  fprintf( fp, "// the writer overwrote, before or during the copy, are skipped.\n");
+  fprintf( fp, "uint32_t %s_gpio_trace_read( uint32_t *tail, %s_TRACE_ENTRY *out, uint32_t n ) {\n", prefix, PREFIX );
+  fprintf( fp, "  uint32_t head, t, i, j, drop;\n");
+  fprintf( fp, "  volatile %s_TRACE_ENTRY *e;\n", PREFIX );
+  fprintf( fp, "  head = %s_gpio_trace_head;\n", prefix );
+  fprintf( fp, "  t = *tail;\n");
+  fprintf( fp, "  // the slot after head may be half written\n");
+  fprintf( fp, "  if(head-t >= %s_TRACE_DEPTH) t = head-%s_TRACE_DEPTH+1;\n", PREFIX, PREFIX );
+  fprintf( fp, "  for(i=0;(i<n) && (t+i!=head);i++) {\n");
+  fprintf( fp, "    e = &%s_gpio_trace_buf[(t+i) & (%s_TRACE_DEPTH-1)];\n", prefix, PREFIX );
+  fprintf( fp, "    out[i].time = e->time;\n");
+  fprintf( fp, "    out[i].pin = e->pin;\n");
+  fprintf( fp, "    out[i].level = e->level;\n");
+  fprintf( fp, "  }\n");
+  fprintf( fp, "  head = %s_gpio_trace_head;\n", prefix );
+  fprintf( fp, "  drop = 0;\n");
+  fprintf( fp, "  if(head-t >= %s_TRACE_DEPTH) drop = head-t-%s_TRACE_DEPTH+1;\n", PREFIX, PREFIX );
+  fprintf( fp, "  if(drop>i) drop = i;\n");
+  fprintf( fp, "  for(j=drop;j<i;j++) out[j-drop] = out[j];\n");
+  fprintf( fp, "  *tail = t+i;\n");
+  fprintf( fp, "  return i-drop;\n");
+  fprintf( fp, "}\n");
+  fprintf( fp, "#endif\n");
+  fprintf( fp, "\n");
+}
+
+//************************************************************************
+// Optional CSV columns
+//************************************************************************
+// The first fourteen columns are positional.  Anything after them is
+// optional and identified by its name in the header row.
+void find_columns( char *lp ) {
+  int i, j, k, len, beg;
+  char name[MAXCHARS];
+  char *np;
+  OPTCOL *oc;
+
+  beg=0;
+  for(i=0;i<MAXFIELDS;i++) {
+    len = strcspn(lp+beg,",");
+    for(j=0,k=0;(j<len) && (k<MAXCHARS-1);j++) {
+      if(lp[beg+j]!='\"') name[k++]=toupper(lp[beg+j]);
+    }
+    name[k]=0;
+    trim_eoline( name );
+    trim_trail( name );
+    np=trim_lead( name );
+    if(i>=14) {
+      for(oc=optcols;oc->name;oc++) {
+        if(0==strcmp(np,oc->name)) {
+          *oc->col=i;
+          fprintf(stderr,"Found optional column %s (%d)\n", oc->name, i+1 );
+          if(i>=nfields) nfields=i+1;
+        }
+      }
+    }
+    if(lp[beg+len] == '\0') break;
+    beg += len + 1;
+  }
+}
+
+
+//************************************************************************
+// Signal groups (multi-pin buses)
+//************************************************************************
+// Members of a GROUP are taken LSB first in CSV order and must all be on
+// one port.  A group whose members sit on consecutive ascending bits is
+// read and written as a single shifted field; any other group is
+// "scattered" and goes through GATHER/SCATTER macros.
+void calc_groups( void ) {
+  int i, j;
+  GROUPDEF *gd;
+
+  ngroups=0;
+  for(i=0;i<nseqs;i++) {
+    if(strlen(pins[i].group)==0) continue;
+    for(j=0;j<ngroups;j++) {
+      if(0==strcmp(groups[j].name,pins[i].group)) break;
+    }
+    gd=&groups[j];
+    if(j==ngroups) {
+      if(ngroups>=MAXGROUPS) {
+        fprintf(stderr,"Warning: too many groups, %s ignored\n", pins[i].group );
+        continue;
+      }
+      ngroups++;
+      strncpy(gd->name,pins[i].group,MAXCHARS);
+      gd->port=pins[i].port;
+      gd->nmembers=0;
+      gd->valid=true;
+    }
+    if(pins[i].port != gd->port) {
+      fprintf(stderr,"Warning: group %s: %s is not on port %d, group skipped\n",
+                       gd->name, pins[i].signame, gd->port );
+      gd->valid=false;
+    }
+    if(gd->nmembers>=32) {
+      fprintf(stderr,"Warning: group %s: more than 32 members, group skipped\n", gd->name );
+      gd->valid=false;
+      continue;
+    }
+    gd->member[gd->nmembers++]=i;
+  }
+
+  for(j=0;j<ngroups;j++) {
+    gd=&groups[j];
+    if(!gd->valid) continue;
+    gd->nruns=1;
+    for(i=1;i<gd->nmembers;i++) {
+      if(pins[gd->member[i]].bit != pins[gd->member[i-1]].bit+1) gd->nruns++;
+    }
+    gd->scattered = (gd->nruns>1);
+    // about 3 instructions per run (shift, mask, or) against about 4 per
+    // lookup (extract byte, load, or), for gather on port lanes plus
+    // scatter on value bytes; two runs are never worth the table space
+    gd->lut = (gd->nruns>2) &&
+              (4*(group_port_lanes(gd)+group_value_bytes(gd)) < 3*2*gd->nruns);
+  }
+}
+
+// byte lanes of the port that hold members
+int group_port_lanes( GROUPDEF *gd ) {
+  int k, n=0;
+  for(k=0;k<4;k++) {
+    if(group_mask(gd) & (0xffUL<<(8*k))) n++;
+  }
+  return n;
+}
+
+// bytes of the logical value
+int group_value_bytes( GROUPDEF *gd ) {
+  return (gd->nmembers+7)/8;
+}
+
+unsigned long group_mask( GROUPDEF *gd ) {
+  int i;
+  unsigned long mask=0;
+  for(i=0;i<gd->nmembers;i++) mask |= 1UL<<pins[gd->member[i]].bit;
+  return mask;
+}
+
+// port bits of active-low members, which get inverted on read and write
+unsigned long group_invert( GROUPDEF *gd ) {
+  int i;
+  unsigned long invert=0;
+  for(i=0;i<gd->nmembers;i++) {
+    if(pins[gd->member[i]].active==0) invert |= 1UL<<pins[gd->member[i]].bit;
+  }
+  return invert;
+}
+
+// WRITE is a paired FIOSET/FIOCLR, so other bits on the port are never
+// disturbed and no FIOMASK save/restore is needed.  Values are logical:
+// a 1 turns the member on regardless of its active level.
+void print_group_macros( FILE *fp ) {
+  int j, lsb, port;
+  unsigned long mask, invert;
+  GROUPDEF *gd;
+  char temp[MAXCHARS];
+  char xorstr[MAXCHARS];
+
+  for(j=0;j<ngroups;j++) {
+    gd=&groups[j];
+    if(!gd->valid) continue;
+    port=gd->port;
+    lsb=pins[gd->member[0]].bit;
+    mask=group_mask(gd);
+    invert=group_invert(gd);
+    sprintf( temp, "%s_%s_PORT", PREFIX, gd->name );
+    fprintf( fp, "#define %-32s    (%d)\n", temp, port );
+    sprintf( temp, "%s_%s_MASK", PREFIX, gd->name );
+    fprintf( fp, "#define %-32s    (0x%08lx)\n", temp, mask );
+    if(!gd->scattered) {
+      sprintf( temp, "%s_%s_SHIFT", PREFIX, gd->name );
+      fprintf( fp, "#define %-32s    (%d)\n", temp, lsb );
+    }
+    sprintf( temp, "%s_%s_WIDTH", PREFIX, gd->name );
+    fprintf( fp, "#define %-32s    (%d)\n", temp, gd->nmembers );
+    sprintf( temp, "%s_%s_INVERT", PREFIX, gd->name );
+    fprintf( fp, "#define %-32s    (0x%08lx)\n", temp, invert );
+
+    if(invert) sprintf( xorstr, " ^ 0x%08lxu", invert );
+    else       xorstr[0]=0;
+    if(gd->scattered) {
+      print_group_scatter_h( fp, gd );
+      fprintf( fp, "#define %s_WRITE_%s(v) do { unsigned int _x = (v); unsigned int _v = %s_SCATTER_%s(_x)%s; "
+                   "LPC_GPIO%d->FIOSET = _v & 0x%08lxu; LPC_GPIO%d->FIOCLR = ~_v & 0x%08lxu; } while(0)\n",
+                   PREFIX, gd->name, PREFIX, gd->name, xorstr, port, mask, port, mask );
+      fprintf( fp, "#define %s_READ_%s() %s_gpio_read_%s()\n", PREFIX, gd->name, prefix, gd->name );
+      fprintf( fp, "extern unsigned int %s_gpio_read_%s( void );\n", prefix, gd->name );
+      fprintf( fp, "\n");
+      continue;
+    }
+    fprintf( fp, "#define %s_WRITE_%s(v) do { unsigned int _v = ((unsigned int)(v) << %d)%s; "
+                 "LPC_GPIO%d->FIOSET = _v & 0x%08lxu; LPC_GPIO%d->FIOCLR = ~_v & 0x%08lxu; } while(0)\n",
+                 PREFIX, gd->name, lsb, xorstr, port, mask, port, mask );
+    fprintf( fp, "#define %s_READ_%s() (((LPC_GPIO%d->FIOPIN%s) & 0x%08lxu) >> %d)\n",
+                 PREFIX, gd->name, port, xorstr, mask, lsb );
+    print_group_lane( fp, gd );
+    fprintf( fp, "\n");
+  }
+}
+
+// A scattered group is moved between value and port bit positions by
+// GATHER (port word to value) and SCATTER (value to port word), either
+// as one shift and mask per run of consecutive bits or, when that takes
+// more steps, as one 256-entry table lookup per port byte lane (gather)
+// and per value byte (scatter).  Either way the cost is fixed, with no
+// per-bit loop.  Both macros evaluate their argument more than once.
+void print_group_scatter_h( FILE *fp, GROUPDEF *gd ) {
+  int i, k, vlo, plo, n;
+  unsigned long vmask, pmask;
+  char temp[MAXCHARS];
+
+  if(gd->lut) {
+    for(k=0;k<4;k++) {
+      if(0==(group_mask(gd) & (0xffUL<<(8*k)))) continue;
+      fprintf( fp, "extern const %s %s_%s_GATHER%d[256];\n", group_value_type(gd), PREFIX, gd->name, k );
+    }
+    for(k=0;k<group_value_bytes(gd);k++) {
+      fprintf( fp, "extern const uint32_t %s_%s_SCATTER%d[256];\n", PREFIX, gd->name, k );
+    }
+    sprintf( temp, "%s_GATHER_%s(w)", PREFIX, gd->name );
+    fprintf( fp, "#define %-32s    (", temp );
+    n=0;
+    for(k=0;k<4;k++) {
+      if(0==(group_mask(gd) & (0xffUL<<(8*k)))) continue;
+      fprintf( fp, "%s%s_%s_GATHER%d[((w) >> %d) & 0xff]", n++ ? " | " : "", PREFIX, gd->name, k, 8*k );
+    }
+    fprintf( fp, ")\n");
+    sprintf( temp, "%s_SCATTER_%s(v)", PREFIX, gd->name );
+    fprintf( fp, "#define %-32s    (", temp );
+    for(k=0;k<group_value_bytes(gd);k++) {
+      fprintf( fp, "%s%s_%s_SCATTER%d[((v) >> %d) & 0xff]", k ? " | " : "", PREFIX, gd->name, k, 8*k );
+    }
+    fprintf( fp, ")\n");
+    return;
+  }
+
+  sprintf( temp, "%s_GATHER_%s(w)", PREFIX, gd->name );
+  fprintf( fp, "#define %-32s    (", temp );
+  for(i=0;i<gd->nmembers;i+=n) {
+    vlo=i;
+    plo=pins[gd->member[i]].bit;
+    for(n=1;(i+n)<gd->nmembers;n++) {
+      if(pins[gd->member[i+n]].bit != plo+n) break;
+    }
+    vmask=((1UL<<n)-1)<<vlo;
+    if(plo>=vlo) fprintf( fp, "%s(((w) >> %d) & 0x%lxu)", i ? " | " : "", plo-vlo, vmask );
+    else         fprintf( fp, "%s(((w) << %d) & 0x%lxu)", i ? " | " : "", vlo-plo, vmask );
+  }
+  fprintf( fp, ")\n");
+  sprintf( temp, "%s_SCATTER_%s(v)", PREFIX, gd->name );
+  fprintf( fp, "#define %-32s    (", temp );
+  for(i=0;i<gd->nmembers;i+=n) {
+    vlo=i;
+    plo=pins[gd->member[i]].bit;
+    for(n=1;(i+n)<gd->nmembers;n++) {
+      if(pins[gd->member[i+n]].bit != plo+n) break;
+    }
+    pmask=((1UL<<n)-1)<<plo;
+    if(plo>=vlo) fprintf( fp, "%s(((v) << %d) & 0x%lxu)", i ? " | " : "", plo-vlo, pmask );
+    else         fprintf( fp, "%s(((v) >> %d) & 0x%lxu)", i ? " | " : "", vlo-plo, pmask );
+  }
+  fprintf( fp, ")\n");
+}
+
+const char *group_value_type( GROUPDEF *gd ) {
+  if(gd->nmembers<=8) return "uint8_t";
+  if(gd->nmembers<=16) return "uint16_t";
+  return "uint32_t";
+}
+
+bool any_lut_group( void ) {
+  int j;
+  for(j=0;j<ngroups;j++) {
+    if(groups[j].valid && groups[j].lut) return true;
+  }
+  return false;
+}
+
+bool any_scattered_group( void ) {
+  int j;
+  for(j=0;j<ngroups;j++) {
+    if(groups[j].valid && groups[j].scattered) return true;
+  }
+  return false;
+}
+
+void print_group_c( FILE *fp ) {
+  int i, j, k, x;
+  unsigned long entry;
+  GROUPDEF *gd;
+
+  for(j=0;j<ngroups;j++) {
+    gd=&groups[j];
+    if(!gd->valid || !gd->scattered) continue;
+    fprintf( fp, "\n");
+    if(gd->lut) {
+      for(k=0;k<4;k++) {
+        if(0==(group_mask(gd) & (0xffUL<<(8*k)))) continue;
+        fprintf( fp, "const %s %s_%s_GATHER%d[256] = {\n", group_value_type(gd), PREFIX, gd->name, k );
+        for(x=0;x<256;x++) {
+          entry=0;
+          for(i=0;i<gd->nmembers;i++) {
+            if(pins[gd->member[i]].bit/8 != k) continue;
+            if(x & (1<<(pins[gd->member[i]].bit%8))) entry |= 1UL<<i;
+          }
+          fprintf( fp, "%s0x%0*lx%s", (x%8) ? " " : "  ", (gd->nmembers+3)/4, entry,
+                             (x==255) ? "\n" : ((x%8)==7) ? ",\n" : "," );
+        }
+        fprintf( fp, "};\n");
+      }
+      for(k=0;k<group_value_bytes(gd);k++) {
+        fprintf( fp, "const uint32_t %s_%s_SCATTER%d[256] = {\n", PREFIX, gd->name, k );
+        for(x=0;x<256;x++) {
+          entry=0;
+          for(i=8*k;(i<8*k+8) && (i<gd->nmembers);i++) {
+            if(x & (1<<(i-8*k))) entry |= 1UL<<pins[gd->member[i]].bit;
+          }
+          fprintf( fp, "%s0x%08lx%s", (x%8) ? " " : "  ", entry,
+                             (x==255) ? "\n" : ((x%8)==7) ? ",\n" : "," );
+        }
+        fprintf( fp, "};\n");
+      }
+      fprintf( fp, "\n");
+    }
+    fprintf( fp, "unsigned int %s_gpio_read_%s( void ) {\n", prefix, gd->name );
+    fprintf( fp, "  unsigned int w = LPC_GPIO%d->FIOPIN ^ 0x%08lxu;\n", gd->port, group_invert(gd) );
+    fprintf( fp, "  return %s_GATHER_%s(w);\n", PREFIX, gd->name );
+    fprintf( fp, "}\n");
+  }
+}
+
+// Byte/halfword lane of a group: the smallest FIOPINn (8) or FIOPINL/H
+// (16) sub-register that holds all of its bits, provided no other GPIO
+// signal shares that lane (a blank FUNC is GPIO too, PINSEL's reset
+// value).  Returns the lane width, 0 if there is none.
+int group_lane( GROUPDEF *gd, int *base ) {
+  int i, width;
+  unsigned long mask, lanemask;
+  mask=group_mask(gd);
+  for(width=8;width<=16;width+=8) {
+    lanemask = (width==8) ? 0xffUL : 0xffffUL;
+    for(*base=0;*base<32;*base+=width) {
+      if(0==(mask & ~(lanemask<<*base))) break;
+    }
+    if(*base<32) break;
+  }
+  if(width>16) return 0;
+  for(i=0;i<nseqs;i++) {
+    if((pins[i].port!=gd->port) || ((pins[i].func!=0) && (pins[i].func!=NA))) continue;
+    if(0==((lanemask<<*base) & (1UL<<pins[i].bit))) continue;
+    if(0==(mask & (1UL<<pins[i].bit))) return 0;
+  }
+  return width;
+}
+
+// With FIOMASK set for every bit in the lane that is not a member (no
+// other GPIO signal is there, so this disturbs nothing), a plain STRB or
+// STRH to the lane writes the whole bus, and a LDRB/LDRH reads it.
+void print_group_lane( FILE *fp, GROUPDEF *gd ) {
+  int width, base, port;
+  unsigned long lanemask, lmask, linvert;
+  char lane[MAXCHARS];
+  char xorstr[MAXCHARS];
+  const char *type;
+
+  width=group_lane( gd, &base );
+  if(width==0) return;
+  port=gd->port;
+  lanemask = (width==8) ? 0xffUL : 0xffffUL;
+  lmask = group_mask(gd)>>base;
+  linvert = group_invert(gd)>>base;
+  if(width==8) sprintf( lane, "%d", base/8 );
+  else         sprintf( lane, "%s", base ? "H" : "L" );
+  type = (width==8) ? "unsigned char" : "unsigned short";
+
+  if(linvert) sprintf( xorstr, " ^ 0x%lxu", linvert );
+  else        xorstr[0]=0;
+  fprintf( fp, "#define %s_%s_LANE_MASK%s (0x%0*lx)  // FIOMASK%s value for this bus\n",
+               PREFIX, gd->name, lane, width/4, ~lmask & lanemask, lane );
+  fprintf( fp, "#define %s_%s_LANE_INIT() (LPC_GPIO%d->FIOMASK%s = 0x%0*lxu)\n",
+               PREFIX, gd->name, port, lane, width/4, ~lmask & lanemask );
+  fprintf( fp, "#define %s_WRITE%d_%s(v) (LPC_GPIO%d->FIOPIN%s = (%s)(((unsigned int)(v) << %d)%s))\n",
+               PREFIX, width, gd->name, port, lane, type, pins[gd->member[0]].bit-base, xorstr );
+  fprintf( fp, "#define %s_READ%d_%s() (((LPC_GPIO%d->FIOPIN%s%s) & 0x%lxu) >> %d)\n",
+               PREFIX, width, gd->name, port, lane, xorstr, lmask, pins[gd->member[0]].bit-base );
+}
+
+
+//************************************************************************
+// Write-combining transactions
+//************************************************************************
+// Staged set/clear macros accumulate into per-port FIOSET/FIOCLR words
+// in RAM; commit then issues at most one FIOSET and one FIOCLR store per
+// port that has signals.  The later of a set and clear of the same bit
+// wins.  The accumulator is a single global, so a transaction must not
+// be interleaved with another one from an ISR.
+bool port_used( int port ) {
+  int i;
+  for(i=0;i<nseqs;i++) {
+    if(pins[i].port==port) return true;
+  }
+  return false;
+}
+
+void print_txn_h( FILE *fp ) {
+  int i;
+  char *on, *off;
+
+  fprintf( fp, "typedef struct tag%s_GPIO_TXN {\n", PREFIX );
+  fprintf( fp, "  uint32_t set[5];\n");
+  fprintf( fp, "  uint32_t clr[5];\n");
+  fprintf( fp, "} %s_GPIO_TXN;\n", PREFIX );
+  fprintf( fp, "extern %s_GPIO_TXN %s_gpio_txn;\n", PREFIX, prefix );
+  fprintf( fp, "extern void %s_gpio_begin( void );\n", prefix );
+  fprintf( fp, "extern void %s_gpio_commit( void );\n", prefix );
+  fprintf( fp, "\n");
+
+  for(i=0;i<nseqs;i++) {
+    if(pins[i].odrain==1) { on="TOPEN"; off="TSINK"; }
+    else                  { on="TSET";  off="TCLR"; }
+    fprintf( fp, "#define %s_%s_%-25s   (%s_gpio_txn.set[%d] |= (1u<<%d), %s_gpio_txn.clr[%d] &= ~(1u<<%d))\n", 
+                        PREFIX, on, pins[i].signame, prefix, pins[i].port, pins[i].bit, prefix, pins[i].port, pins[i].bit );
+    fprintf( fp, "#define %s_%s_%-25s   (%s_gpio_txn.clr[%d] |= (1u<<%d), %s_gpio_txn.set[%d] &= ~(1u<<%d))\n", 
+                        PREFIX, off, pins[i].signame, prefix, pins[i].port, pins[i].bit, prefix, pins[i].port, pins[i].bit );
+    if(pins[i].odrain==1) continue;
+    if(pins[i].active==1)      { on="TSET"; off="TCLR"; }
+    else if(pins[i].active==0) { on="TCLR"; off="TSET"; }
+    else continue;
+    fprintf( fp, "#define %s_TON_%-25s    (%s_%s_%s)\n", PREFIX, pins[i].signame, PREFIX, on, pins[i].signame );
+    fprintf( fp, "#define %s_TOFF_%-25s   (%s_%s_%s)\n", PREFIX, pins[i].signame, PREFIX, off, pins[i].signame );
+  }
+  fprintf( fp, "\n");
+}
+
+void print_txn_c( FILE *fp ) {
+  int port;
+  fprintf( fp, "\n");
+  fprintf( fp, "%s_GPIO_TXN %s_gpio_txn;\n", PREFIX, prefix );
+  fprintf( fp, "\n");
+  fprintf( fp, "void %s_gpio_begin( void ) {\n", prefix );
+  for(port=0;port<5;port++) {
+    if(!port_used(port)) continue;
+    fprintf( fp, "  %s_gpio_txn.set[%d] = 0;\n", prefix, port );
+    fprintf( fp, "  %s_gpio_txn.clr[%d] = 0;\n", prefix, port );
+  }
+  fprintf( fp, "}\n");
+  fprintf( fp, "\n");
+  fprintf( fp, "void %s_gpio_commit( void ) {\n", prefix );
+  for(port=0;port<5;port++) {
+    if(!port_used(port)) continue;
+    fprintf( fp, "  if(%s_gpio_txn.set[%d]) LPC_GPIO%d->FIOSET = %s_gpio_txn.set[%d];\n",
+                       prefix, port, port, prefix, port );
+    fprintf( fp, "  if(%s_gpio_txn.clr[%d]) LPC_GPIO%d->FIOCLR = %s_gpio_txn.clr[%d];\n",
+                       prefix, port, port, prefix, port );
+  }
+  fprintf( fp, "  %s_gpio_begin();\n", prefix );
+  fprintf( fp, "}\n");
+}
+
+
+//************************************************************************
+// Bulk all-off / restore-defaults
+//************************************************************************
+// Per-port masks over the GPIO outputs (FUNC 0, IN/OUT 0).  OFF drives
+// every output to its inactive level (active-low outputs are set,
+// active-high cleared), DEF to its DEF column value.  Each routine is
+// one FIOSET and one FIOCLR store per port with outputs.
+void calc_bulk( void ) {
+  int i;
+  int bit, port;
+  for(i=0;i<5;i++) {
+    OFF_SETMASK[i]=0;
+    OFF_CLRMASK[i]=0;
+    DEF_SETMASK[i]=0;
+    DEF_CLRMASK[i]=0;
+  }
+  for(i=0;i<nseqs;i++) {
+    if(pins[i].func!=0 || pins[i].inout!=OUT) continue;
+    bit = pins[i].bit;
+    port = pins[i].port;
+    if(pins[i].active==0) OFF_SETMASK[port] |= (1UL<<bit);
+    else                  OFF_CLRMASK[port] |= (1UL<<bit);
+    if(pins[i].def==1)    DEF_SETMASK[port] |= (1UL<<bit);
+    else                  DEF_CLRMASK[port] |= (1UL<<bit);
+  }
+}
+
+void print_bulk_h( FILE *fp ) {
+  int i;
+  for(i=0;i<5;i++) {
+    fprintf( fp, "#define %s_OFF_SETMASK%d (0x%08lx)\n", PREFIX, i, OFF_SETMASK[i] );
+    fprintf( fp, "#define %s_OFF_CLRMASK%d (0x%08lx)\n", PREFIX, i, OFF_CLRMASK[i] );
+  }
+  fprintf( fp, "\n");
+  for(i=0;i<5;i++) {
+    fprintf( fp, "#define %s_DEF_SETMASK%d (0x%08lx)\n", PREFIX, i, DEF_SETMASK[i] );
+    fprintf( fp, "#define %s_DEF_CLRMASK%d (0x%08lx)\n", PREFIX, i, DEF_CLRMASK[i] );
+  }
+  fprintf( fp, "\n");
+  fprintf( fp, "extern void %s_gpio_all_off( void );\n", prefix );
+  fprintf( fp, "extern void %s_gpio_restore_defaults( void );\n", prefix );
+  fprintf( fp, "\n");
+}
+
+void print_bulk_c( FILE *fp ) {
+  int i;
+  fprintf( fp, "\n");
+  fprintf( fp, "void %s_gpio_all_off( void ) {\n", prefix );
+  for(i=0;i<5;i++) {
+    if(OFF_SETMASK[i]) fprintf( fp, "  LPC_GPIO%d->FIOSET = %s_OFF_SETMASK%d;\n", i, PREFIX, i );
+    if(OFF_CLRMASK[i]) fprintf( fp, "  LPC_GPIO%d->FIOCLR = %s_OFF_CLRMASK%d;\n", i, PREFIX, i );
+  }
+  fprintf( fp, "}\n");
+  fprintf( fp, "\n");
+  fprintf( fp, "void %s_gpio_restore_defaults( void ) {\n", prefix );
+  for(i=0;i<5;i++) {
+    if(DEF_SETMASK[i]) fprintf( fp, "  LPC_GPIO%d->FIOSET = %s_DEF_SETMASK%d;\n", i, PREFIX, i );
+    if(DEF_CLRMASK[i]) fprintf( fp, "  LPC_GPIO%d->FIOCLR = %s_DEF_CLRMASK%d;\n", i, PREFIX, i );
+  }
+  fprintf( fp, "}\n");
+}
+
+
+//************************************************************************
+// Input snapshot
+//************************************************************************
+// zebra_gpio_sample() reads FIOPIN once per port with GPIO signals and
+// XORs in the active-low bits, so a 1 in the snapshot always means the
+// signal is on.  The changed words hold the bits that differ from the
+// previous sample held in the same snapshot.
+bool port_has_gpio( int port ) {
+  int i;
+  for(i=0;i<nseqs;i++) {
+    if((pins[i].port==port) && (pins[i].func==0)) return true;
+  }
+  return false;
+}
+
+void calc_POLARITY( void ) {
+  int i;
+  for(i=0;i<5;i++) POLARITY[i]=0;
+  for(i=0;i<nseqs;i++) {
+    if(pins[i].func!=0) continue;
+    if(pins[i].active==0) POLARITY[pins[i].port] |= (1UL<<pins[i].bit);
+  }
+}
+
+void print_snapshot_h( FILE *fp ) {
+  int i;
+  char temp[MAXCHARS];
+  for(i=0;i<5;i++) {
+    fprintf( fp, "#define %s_POLARITY%d (0x%08lx)\n", PREFIX, i, POLARITY[i] );
+  }
+  fprintf( fp, "\n");
+  fprintf( fp, "typedef struct tag%s_GPIO_SNAPSHOT {\n", PREFIX );
+  fprintf( fp, "  uint32_t port[5];     // logical levels, 1 = on\n");
+  fprintf( fp, "  uint32_t changed[5];  // bits changed since the previous sample\n");
+  fprintf( fp, "} %s_GPIO_SNAPSHOT;\n", PREFIX );
+  fprintf( fp, "extern void %s_gpio_sample( %s_GPIO_SNAPSHOT *snap );\n", prefix, PREFIX );
+  fprintf( fp, "\n");
+  for(i=0;i<nseqs;i++) {
+    if(pins[i].func!=0) continue;
+    sprintf( temp, "%s_SNAP_%s(s)", PREFIX, pins[i].signame );
+    fprintf( fp, "#define %-40s (((s)->port[%d] >> %d) & 1)\n", temp, pins[i].port, pins[i].bit );
+    sprintf( temp, "%s_SNAP_CHANGED_%s(s)", PREFIX, pins[i].signame );
+    fprintf( fp, "#define %-40s (((s)->changed[%d] >> %d) & 1)\n", temp, pins[i].port, pins[i].bit );
+  }
+  fprintf( fp, "\n");
+}
+
+void print_snapshot_c( FILE *fp ) {
+  int port;
+  fprintf( fp, "\n");
+  fprintf( fp, "void %s_gpio_sample( %s_GPIO_SNAPSHOT *snap ) {\n", prefix, PREFIX );
+  fprintf( fp, "  uint32_t v;\n");
+  for(port=0;port<5;port++) {
+    if(!port_has_gpio(port)) continue;
+    if(POLARITY[port]) fprintf( fp, "  v = LPC_GPIO%d->FIOPIN ^ %s_POLARITY%d;\n", port, PREFIX, port );
+    else               fprintf( fp, "  v = LPC_GPIO%d->FIOPIN;\n", port );
+    fprintf( fp, "  snap->changed[%d] = v ^ snap->port[%d];\n", port, port );
+    fprintf( fp, "  snap->port[%d] = v;\n", port );
+  }
+  fprintf( fp, "}\n");
+}
+
+
+//************************************************************************
+// GPIO interrupts
+//************************************************************************
+// Only P0.0-11, P0.15-30 and P2.0-13 can interrupt (IRQ_CAPABLE), all
+// through the EINT3 vector.  The generated EINT3_IRQHandler masks each
+// port's status with the enabled bits, clears them with one IOxIntClr
+// write, then dispatches through a const table indexed by __CLZ of the
+// remaining status, so the cost per pending pin doesn't depend on how
+// many pins are enabled.  The table is stored highest bit first so CLZ
+// indexes it directly.
+const unsigned long IRQ_CAPABLE[5] = { 0x7fff8fffUL, 0, 0x00003fffUL, 0, 0 };
+
+void calc_irq( void ) {
+  int i;
+  char *cp;
+  char edge[MAXCHARS];
+  for(i=0;i<nseqs;i++) {
+    pins[i].irq_edge=0;
+    pins[i].irq_handler[0]=0;
+    if(strlen(pins[i].irq)==0) continue;
+    cp=strchr(pins[i].irq,':');
+    if(!cp) {
+      fprintf(stderr,"Warning: %s: IRQ '%s' should be EDGE:handler, ignored\n",
+                       pins[i].signame, pins[i].irq );
+      continue;
+    }
+    strncpy(edge,pins[i].irq,MAXCHARS);
+    edge[cp-pins[i].irq]=0;
+    trim_trail(edge);
+    for(cp=edge;*cp;cp++) *cp=toupper(*cp);
+    strncpy(pins[i].irq_handler,trim_lead(strchr(pins[i].irq,':')+1),MAXCHARS);
+    if(0==strcmp(edge,"RISE"))      pins[i].irq_edge=IRQ_RISE;
+    else if(0==strcmp(edge,"FALL")) pins[i].irq_edge=IRQ_FALL;
+    else if(0==strcmp(edge,"BOTH")) pins[i].irq_edge=IRQ_RISE|IRQ_FALL;
+    else {
+      fprintf(stderr,"Warning: %s: unknown IRQ edge '%s', ignored\n", pins[i].signame, edge );
+      continue;
+    }
+    if((pins[i].port>4) || (pins[i].bit>31) || !(IRQ_CAPABLE[pins[i].port] & (1UL<<pins[i].bit))) {
+      fprintf(stderr,"Warning: %s: GPIO interrupts are only on P0.0-11, P0.15-30 and P2.0-13, IRQ ignored\n",
+                       pins[i].signame );
+      pins[i].irq_edge=0;
+    }
+    if(strlen(pins[i].irq_handler)==0) {
+      fprintf(stderr,"Warning: %s: IRQ has no handler name, ignored\n", pins[i].signame );
+      pins[i].irq_edge=0;
+    }
+    if(pins[i].irq_edge && (pins[i].func!=0)) {
+      fprintf(stderr,"Warning: %s: IRQ on a pin not set to GPIO (FUNC %d)\n",
+                       pins[i].signame, pins[i].func );
+    }
+  }
+}
+
+bool any_irq( void ) {
+  int i;
+  for(i=0;i<nseqs;i++) {
+    if(pins[i].irq_edge) return true;
+  }
+  return false;
+}
+
+unsigned long irq_mask( int port, int edge ) {
+  int i;
+  unsigned long mask=0;
+  for(i=0;i<nseqs;i++) {
+    if((pins[i].port==port) && (pins[i].irq_edge & edge)) mask |= (1UL<<pins[i].bit);
+  }
+  return mask;
+}
+
+void print_irq_h( FILE *fp ) {
+  int i, j, port;
+  for(port=0;port<=2;port+=2) {
+    fprintf( fp, "#define %s_IO%dINTENR_INIT (0x%08lx)\n", PREFIX, port, irq_mask(port,IRQ_RISE) );
+    fprintf( fp, "#define %s_IO%dINTENF_INIT (0x%08lx)\n", PREFIX, port, irq_mask(port,IRQ_FALL) );
+  }
+  fprintf( fp, "\n");
+  for(i=0;i<nseqs;i++) {
+    if(!pins[i].irq_edge) continue;
+    for(j=0;j<i;j++) { // declare each handler once
+      if(pins[j].irq_edge && (0==strcmp(pins[j].irq_handler,pins[i].irq_handler))) break;
+    }
+    if(j<i) continue;
+    fprintf( fp, "extern void %s( void );\n", pins[i].irq_handler );
+  }
+  fprintf( fp, "extern void %s_gpio_irq_init( void );\n", prefix );
+  fprintf( fp, "\n");
+}
+
+void print_irq_c( FILE *fp ) {
+  int i, n, port;
+  char *handler;
+  fprintf( fp, "\n");
+  for(port=0;port<=2;port+=2) {
+    if(0==irq_mask(port,IRQ_RISE|IRQ_FALL)) continue;
+    fprintf( fp, "// indexed by __CLZ(status), i.e. entry n is bit 31-n\n");
+    fprintf( fp, "static void (* const %s_irq%d_table[32])( void ) = {\n", prefix, port );
+    for(n=0;n<32;n++) {
+      handler="0";
+      for(i=0;i<nseqs;i++) {
+        if((pins[i].port==port) && (pins[i].bit==31-n) && pins[i].irq_edge) handler=pins[i].irq_handler;
+      }
+      fprintf( fp, "    %s,  // bit %d\n", handler, 31-n );
+    }
+    fprintf( fp, "};\n");
+    fprintf( fp, "\n");
+  }
+
+  fprintf( fp, "void %s_gpio_irq_init( void ) {\n", prefix );
+  for(port=0;port<=2;port+=2) {
+    if(0==irq_mask(port,IRQ_RISE|IRQ_FALL)) continue;
+    fprintf( fp, "  LPC_GPIOINT->IO%dIntClr = 0xffffffff;\n", port );
+    fprintf( fp, "  LPC_GPIOINT->IO%dIntEnR = %s_IO%dINTENR_INIT;\n", port, PREFIX, port );
+    fprintf( fp, "  LPC_GPIOINT->IO%dIntEnF = %s_IO%dINTENF_INIT;\n", port, PREFIX, port );
+  }
+  fprintf( fp, "  NVIC_EnableIRQ(EINT3_IRQn);\n");
+  fprintf( fp, "}\n");
+  fprintf( fp, "\n");
+
+  fprintf( fp, "void EINT3_IRQHandler( void ) {\n");
+  fprintf( fp, "  uint32_t st, n;\n");
+  for(port=0;port<=2;port+=2) {
+    if(0==irq_mask(port,IRQ_RISE|IRQ_FALL)) continue;
+    fprintf( fp, "  st = (LPC_GPIOINT->IO%dIntStatR & %s_IO%dINTENR_INIT) |\n", port, PREFIX, port );
+    fprintf( fp, "       (LPC_GPIOINT->IO%dIntStatF & %s_IO%dINTENF_INIT);\n", port, PREFIX, port );
+    fprintf( fp, "  if(st) {\n");
+    fprintf( fp, "    LPC_GPIOINT->IO%dIntClr = st;\n", port );
+    fprintf( fp, "    do {\n");
+    fprintf( fp, "      n = __CLZ(st);\n");
+    fprintf( fp, "      st &= ~(0x80000000u >> n);\n");
+    fprintf( fp, "      %s_irq%d_table[n]();\n", prefix, port );
+    fprintf( fp, "    } while(st);\n");
+    fprintf( fp, "  }\n");
+  }
+  fprintf( fp, "}\n");
+}
+
+
+//************************************************************************
+// Sleep profile
+//************************************************************************
+// The SLEEP_ columns give a second set of register images.  Entering
+// and leaving sleep writes only what differs between the two, in an
+// order that never drives a pin before its level is set: FIOMASK (so
+// the latch writes land), PINSEL for pins going to a peripheral, output
+// latches, PINMODE, FIODIR, then PINSEL for pins coming back to GPIO.
+// Latches changed for sleep are saved on entry and put back on exit;
+// everything else is restored from the run images in the CSV.
+typedef struct tagREGIMAGE {
+  unsigned long PINSEL[11];
+  unsigned long PINMODE[10];
+  unsigned long PINMODE_OD[5];
+  unsigned long FIODIR[5];
+  unsigned long FIOPIN[5];
+  unsigned long FIOMASK[5];
+} REGIMAGE;
+
+// snapshot of the register images calc_*() left in the globals
+void save_image( REGIMAGE *ri ) {
+  int i;
+  for(i=0;i<11;i++) ri->PINSEL[i]=PINSEL[i];
+  for(i=0;i<10;i++) ri->PINMODE[i]=PINMODE[i];
+  for(i=0;i<5;i++) {
+    ri->PINMODE_OD[i]=PINMODE_OD[i];
+    ri->FIODIR[i]=FIODIR[i];
+    ri->FIOPIN[i]=FIOPIN[i];
+    ri->FIOMASK[i]=FIOMASK[i];
+  }
+}
+
+// PINSEL with only the fields whose new function is a peripheral taken
+// from the new image.  Written before the latches and FIODIR, so a pin
+// handed to a peripheral is never driven as a GPIO output on the way.
+unsigned long pinsel_to_func( REGIMAGE *from, REGIMAGE *to, int reg ) {
+  int f;
+  unsigned long v=from->PINSEL[reg];
+  for(f=0;f<32;f+=2) {
+    if((to->PINSEL[reg] >> f) & 3) v = (v & ~(3UL<<f)) | (to->PINSEL[reg] & (3UL<<f));
+  }
+  return v;
+}
+
+// First half of a transition between images: PINSEL for pins going to
+// a peripheral.  Returns the write count; fp NULL only counts.
+int print_pinsel_to_func( FILE *fp, REGIMAGE *from, REGIMAGE *to ) {
+  int i, n=0;
+  unsigned long v;
+  for(i=0;i<11;i++) {
+    v=pinsel_to_func( from, to, i );
+    if(v!=from->PINSEL[i]) {
+      if(fp) fprintf( fp, "  LPC_PINCON->PINSEL%d = 0x%08lxu;\n", i, v );
+      n++;
+    }
+  }
+  return n;
+}
+
+// Second half, after the latches: PINMODE, PINMODE_OD, FIODIR (only the
+// differing bits), then PINSEL for the pins coming back to GPIO.
+// FIOMASK is left to the caller.  Returns the write count.
+int print_image_delta( FILE *fp, REGIMAGE *from, REGIMAGE *to ) {
+  int i, n=0;
+  unsigned long diff;
+  for(i=0;i<10;i++) {
+    if(to->PINMODE[i]!=from->PINMODE[i]) {
+      if(fp) fprintf( fp, "  LPC_PINCON->PINMODE%d = 0x%08lxu;\n", i, to->PINMODE[i] );
+      n++;
+    }
+  }
+  for(i=0;i<5;i++) {
+    if(to->PINMODE_OD[i]!=from->PINMODE_OD[i]) {
+      if(fp) fprintf( fp, "  LPC_PINCON->PINMODE_OD%d = 0x%08lxu;\n", i, to->PINMODE_OD[i] );
+      n++;
+    }
+  }
+  for(i=0;i<5;i++) {
+    diff = to->FIODIR[i] ^ from->FIODIR[i];
+    if(diff) {
+      if(fp) fprintf( fp, "  LPC_GPIO%d->FIODIR = (LPC_GPIO%d->FIODIR & ~0x%08lxu) | 0x%08lxu;\n",
+                              i, i, diff, to->FIODIR[i] & diff );
+      n++;
+    }
+  }
+  for(i=0;i<11;i++) {
+    if(to->PINSEL[i]!=pinsel_to_func( from, to, i )) {
+      if(fp) fprintf( fp, "  LPC_PINCON->PINSEL%d = 0x%08lxu;\n", i, to->PINSEL[i] );
+      n++;
+    }
+  }
+  return n;
+}
+
+REGIMAGE run_image, sleep_image;
+unsigned long SLEEP_SETMASK[5];   // latches set on entry
+unsigned long SLEEP_CLRMASK[5];   // latches cleared on entry
+unsigned long SLEEP_UNMASK[5];    // FIOMASK bits opened while asleep
+
+bool any_sleep( void ) {
+  int i;
+  for(i=0;i<nseqs;i++) {
+    if((pins[i].sleep_func!=NA) || (pins[i].sleep_inout!=NA) ||
+       (pins[i].sleep_mode!=NA) || (pins[i].sleep_def!=NA)) return true;
+  }
+  return false;
+}
+
+void calc_sleep( void ) {
+  int i, port, bit, reg, bit2;
+  save_image( &run_image );
+  sleep_image=run_image;
+  for(i=0;i<5;i++) SLEEP_SETMASK[i]=SLEEP_CLRMASK[i]=SLEEP_UNMASK[i]=0;
+
+  for(i=0;i<nseqs;i++) {
+    port = pins[i].port;
+    bit = pins[i].bit;
+    reg = port*2 + bit/16;
+    bit2 = 2*(bit%16);
+    if(pins[i].sleep_func!=NA) {
+      sleep_image.PINSEL[reg] &= ~(0x03UL << bit2);
+      sleep_image.PINSEL[reg] |= ((unsigned long)pins[i].sleep_func << bit2);
+    }
+    if(pins[i].sleep_mode!=NA) {
+      sleep_image.PINMODE[reg] &= ~(0x03UL << bit2);
+      sleep_image.PINMODE[reg] |= ((unsigned long)pins[i].sleep_mode << bit2);
+    }
+    if(pins[i].sleep_inout==IN)  sleep_image.FIODIR[port] &= ~(1UL<<bit);
+    if(pins[i].sleep_inout==OUT) sleep_image.FIODIR[port] |=  (1UL<<bit);
+    if(pins[i].sleep_def==1) SLEEP_SETMASK[port] |= (1UL<<bit);
+    if(pins[i].sleep_def==0) SLEEP_CLRMASK[port] |= (1UL<<bit);
+    if((pins[i].sleep_def!=NA) && (FIOMASK[port] & (1UL<<bit))) SLEEP_UNMASK[port] |= (1UL<<bit);
+  }
+}
+
+// Returns the register writes, for the wakeup-latency comment; fp NULL
+// only counts.  The latch is saved from FIOSET, which reads back what
+// was written, not the pin: an open-drain line held low from outside
+// must not come back driven low.
+int print_sleep_transition( FILE *fp, REGIMAGE *from, REGIMAGE *to, bool entering ) {
+  int i, n=0;
+  unsigned long m;
+  for(i=0;i<5;i++) {
+    if(entering && SLEEP_UNMASK[i]) {
+      if(fp) fprintf( fp, "  LPC_GPIO%d->FIOMASK &= ~0x%08lxu;\n", i, SLEEP_UNMASK[i] );
+      n++;
+    }
+  }
+  n += print_pinsel_to_func( fp, from, to );
+  for(i=0;i<5;i++) {
+    m = SLEEP_SETMASK[i] | SLEEP_CLRMASK[i];
+    if(!m) continue;
+    if(entering) {
+      if(fp) fprintf( fp, "  %s_gpio_sleep_latch[%d] = LPC_GPIO%d->FIOSET & 0x%08lxu;\n", prefix, i, i, m );
+      if(SLEEP_SETMASK[i]) {
+        if(fp) fprintf( fp, "  LPC_GPIO%d->FIOSET = 0x%08lxu;\n", i, SLEEP_SETMASK[i] );
+        n++;
+      }
+      if(SLEEP_CLRMASK[i]) {
+        if(fp) fprintf( fp, "  LPC_GPIO%d->FIOCLR = 0x%08lxu;\n", i, SLEEP_CLRMASK[i] );
+        n++;
+      }
+    } else {
+      if(fp) fprintf( fp, "  LPC_GPIO%d->FIOSET = %s_gpio_sleep_latch[%d];\n", i, prefix, i );
+      if(fp) fprintf( fp, "  LPC_GPIO%d->FIOCLR = %s_gpio_sleep_latch[%d] ^ 0x%08lxu;\n", i, prefix, i, m );
+      n+=2;
+    }
+  }
+  n += print_image_delta( fp, from, to );
+  for(i=0;i<5;i++) {
+    if(!entering && SLEEP_UNMASK[i]) {
+      if(fp) fprintf( fp, "  LPC_GPIO%d->FIOMASK |= 0x%08lxu;\n", i, SLEEP_UNMASK[i] );
+      n++;
+    }
+  }
+  return n;
+}
+
+void print_sleep_h( FILE *fp ) {
+  fprintf( fp, "// sleep profile: %d register writes to enter, %d to exit\n",
+                  print_sleep_transition( NULL, &run_image, &sleep_image, true ),
+                  print_sleep_transition( NULL, &sleep_image, &run_image, false ) );
+  fprintf( fp, "extern void %s_gpio_enter_sleep( void );\n", prefix );
+  fprintf( fp, "extern void %s_gpio_exit_sleep( void );\n", prefix );
+  fprintf( fp, "\n");
+}
+
+void print_sleep_c( FILE *fp ) {
+  fprintf( fp, "\n");
+  fprintf( fp, "static uint32_t %s_gpio_sleep_latch[5];\n", prefix );
+  fprintf( fp, "\n");
+  fprintf( fp, "void %s_gpio_enter_sleep( void ) {\n", prefix );
+  print_sleep_transition( fp, &run_image, &sleep_image, true );
+  fprintf( fp, "}\n");
+  fprintf( fp, "\n");
+  fprintf( fp, "void %s_gpio_exit_sleep( void ) {\n", prefix );
+  print_sleep_transition( fp, &sleep_image, &run_image, false );
+  fprintf( fp, "}\n");
+}
+
+
+//************************************************************************
+// Pinout revision diff
+//************************************************************************
+// mkpins diff old.csv new.csv prefix
+// Both CSVs go through the normal reader and register calculation.
+// Signals are joined on port/bit through a 5x32 index per revision, so
+// the cost is linear in the number of rows.  The report goes to stdout
+// and prefix_gpio_migrate.c gets a routine that applies only the
+// differing writes, in the same order as the sleep transitions.
+PINDEF old_pins[MAXPINS];
+int nold;
+
+void build_index( int index[5][32], PINDEF *pp, int n ) {
+  int i, port, bit;
+  for(port=0;port<5;port++) {
+    for(bit=0;bit<32;bit++) index[port][bit]=-1;
+  }
+  for(i=0;i<n;i++) {
+    if((pp[i].port>4) || (pp[i].bit>31)) continue;
+    index[pp[i].port][pp[i].bit]=i;
+  }
+}
+
+// one "FIELD a->b" note per changed column, returns the count
+int diff_fields( char *out, PINDEF *a, PINDEF *b ) {
+  int n=0;
+  out[0]=0;
+#define DIFF_FIELD(name,f) \
+  if(a->f!=b->f) { sprintf( out+strlen(out), " %s %d->%d", name, a->f, b->f ); n++; }
+  DIFF_FIELD("FUNC",func)
+  DIFF_FIELD("DIR",inout)
+  DIFF_FIELD("MODE",mode)
+  DIFF_FIELD("OD",odrain)
+  DIFF_FIELD("DEF",def)
+  DIFF_FIELD("ACT",active)
+#undef DIFF_FIELD
+  return n;
+}
+
+void print_reg_diff( const char *name, int i, unsigned long a, unsigned long b ) {
+  char temp[MAXCHARS];
+  if(a==b) return;
+  sprintf( temp, "%s%d", name, i );
+  printf( "  %-12s 0x%08lx -> 0x%08lx  bits 0x%08lx\n", temp, a, b, a^b );
+}
+
+int mkpins_diff( char *fname_old, char *fname_new ) {
+  static int old_index[5][32], new_index[5][32];
+  int i, port, bit, nsig, nwrites, err;
+  unsigned long m;
+  PINDEF *a, *b;
+  REGIMAGE old_image, new_image;
+  char notes[MAXCHARS];
+  FILE *fin, *fout;
+
+  fin=fopen( fname_old, "r" );
+  if(!fin) {
+    fprintf(stderr,"Error opening input file: %s\n", fname_old );
+    return 99;
+  }
+  clear_images();
+  err=read_csv( fin );
+  fclose(fin);
+  if(err) return err;
+  calc_PINSEL(); calc_PINMODE(); calc_FIODIR(); calc_FIOPIN(); calc_FIOMASK();
+  save_image( &old_image );
+  for(i=0;i<nseqs;i++) old_pins[i]=pins[i];
+  nold=nseqs;
+
+  fin=fopen( fname_new, "r" );
+  if(!fin) {
+    fprintf(stderr,"Error opening input file: %s\n", fname_new );
+    return 99;
+  }
+  clear_images();
+  err=read_csv( fin );
+  fclose(fin);
+  if(err) return err;
+  calc_PINSEL(); calc_PINMODE(); calc_FIODIR(); calc_FIOPIN(); calc_FIOMASK();
+  save_image( &new_image );
+
+  build_index( old_index, old_pins, nold );
+  build_index( new_index, pins, nseqs );
+
+  printf( "mkpins diff %s -> %s\n", fname_old, fname_new );
+  printf( "Signals:\n");
+  nsig=0;
+  for(port=0;port<5;port++) {
+    for(bit=0;bit<32;bit++) {
+      a = (old_index[port][bit]<0) ? NULL : &old_pins[old_index[port][bit]];
+      b = (new_index[port][bit]<0) ? NULL : &pins[new_index[port][bit]];
+      if(!a && !b) continue;
+      if(!a) {
+        printf( "  P%d.%-2d  added    %s\n", port, bit, b->signame );
+      } else if(!b) {
+        printf( "  P%d.%-2d  removed  %s\n", port, bit, a->signame );
+      } else {
+        diff_fields( notes, a, b );
+        if(0!=strcmp(a->signame,b->signame)) {
+          printf( "  P%d.%-2d  renamed  %s -> %s%s\n", port, bit, a->signame, b->signame, notes );
+        } else if(notes[0]) {
+          printf( "  P%d.%-2d  changed  %s%s\n", port, bit, b->signame, notes );
+        } else {
+          continue;
+        }
+      }
+      nsig++;
+    }
+  }
+  if(nsig==0) printf( "  none\n");
+
+  printf( "Registers:\n");
+  for(i=0;i<11;i++) print_reg_diff( "PINSEL", i, old_image.PINSEL[i], new_image.PINSEL[i] );
+  for(i=0;i<10;i++) print_reg_diff( "PINMODE", i, old_image.PINMODE[i], new_image.PINMODE[i] );
+  for(i=0;i<5;i++)  print_reg_diff( "PINMODE_OD", i, old_image.PINMODE_OD[i], new_image.PINMODE_OD[i] );
+  for(i=0;i<5;i++)  print_reg_diff( "FIODIR", i, old_image.FIODIR[i], new_image.FIODIR[i] );
+  for(i=0;i<5;i++)  print_reg_diff( "FIOPIN", i, old_image.FIOPIN[i], new_image.FIOPIN[i] );
+  for(i=0;i<5;i++)  print_reg_diff( "FIOMASK", i, old_image.FIOMASK[i], new_image.FIOMASK[i] );
+
+  sprintf( fname_out_c, "%s_gpio_migrate.c", prefix );
+  fout=fopen( fname_out_c, "w" );
+  if(!fout) {
+    fprintf(stderr,"Error opening C output file: %s\n", fname_out_c );
+    return 99;
+  }
+  fprintf( fout, "//************************************************************************\n");
+  fprintf( fout, "//***  NOTE:  This file was automatically generated by MKPINS\n");
+  fprintf( fout, "//***  Processing Date/Time:     %s\n", mkpins_date_time );
+  fprintf( fout, "//***  Migration from:           %s\n", fname_old );
+  fprintf( fout, "//***  Migration to:             %s\n", fname_new );
+  fprintf( fout, "//************************************************************************\n");
+  fprintf( fout, "\n");
+  fprintf( fout, "#include \"LPC17xx.h\"\n");
+  fprintf( fout, "\n");
+  fprintf( fout, "void %s_gpio_migrate( void ) {\n", prefix );
+  nwrites=0;
+  // open FIOMASK for bits that become GPIO, so their latch writes land
+  for(i=0;i<5;i++) {
+    m = old_image.FIOMASK[i] & ~new_image.FIOMASK[i];
+    if(m) {
+      fprintf( fout, "  LPC_GPIO%d->FIOMASK &= ~0x%08lxu;\n", i, m );
+      nwrites++;
+    }
+  }
+  nwrites += print_pinsel_to_func( fout, &old_image, &new_image );
+  for(i=0;i<5;i++) {
+    m = (old_image.FIOPIN[i] ^ new_image.FIOPIN[i]) & ~new_image.FIOMASK[i];
+    if(m & new_image.FIOPIN[i]) {
+      fprintf( fout, "  LPC_GPIO%d->FIOSET = 0x%08lxu;\n", i, m & new_image.FIOPIN[i] );
+      nwrites++;
+    }
+    if(m & ~new_image.FIOPIN[i]) {
+      fprintf( fout, "  LPC_GPIO%d->FIOCLR = 0x%08lxu;\n", i, m & ~new_image.FIOPIN[i] );
+      nwrites++;
+    }
+  }
+  nwrites += print_image_delta( fout, &old_image, &new_image );
+  for(i=0;i<5;i++) {
+    m = new_image.FIOMASK[i] & ~old_image.FIOMASK[i];
+    if(m) {
+      fprintf( fout, "  LPC_GPIO%d->FIOMASK |= 0x%08lxu;\n", i, m );
+      nwrites++;
+    }
+  }
+  fprintf( fout, "}\n");
+  fclose(fout);
+
+  printf( "%d signals changed, %d register writes in %s_gpio_migrate() (%s)\n",
+             nsig, nwrites, prefix, fname_out_c );
+  return 0;
+}
+
+
+//************************************************************************
+// Vertical-counter debounce
+//************************************************************************
+// Each port keeps a 2-bit counter per bit, stored as two bitplane words.
+// A bit's counter runs while the sample differs from the debounced
+// state and resets as soon as it agrees again; after four consecutive
+// differing ticks the state flips.  All 32 bits of a port are handled
+// by the same few word operations, so a tick costs O(ports), not O(pins).
+// Levels are logical (active-low inputs are inverted).
+void check_debounce( void ) {
+  int i;
+  for(i=0;i<nseqs;i++) {
+    if(pins[i].debounce && ((pins[i].func!=0) || (pins[i].inout!=IN))) {
+      fprintf(stderr,"Warning: %s: DEBOUNCE needs a GPIO input, ignored\n", pins[i].signame );
+      pins[i].debounce=0;
+    }
+  }
+}
+
+unsigned long debounce_mask( int port ) {
+  int i;
+  unsigned long mask=0;
+  for(i=0;i<nseqs;i++) {
+    if((pins[i].port==port) && pins[i].debounce) mask |= (1UL<<pins[i].bit);
+  }
+  return mask;
+}
+
+bool any_debounce( void ) {
+  int i;
+  for(i=0;i<nseqs;i++) {
+    if(pins[i].debounce) return true;
+  }
+  return false;
+}
+
+void print_debounce_h( FILE *fp ) {
+  int i;
+  char temp[MAXCHARS];
+  for(i=0;i<5;i++) {
+    fprintf( fp, "#define %s_DEBOUNCE_MASK%d (0x%08lx)\n", PREFIX, i, debounce_mask(i) );
+  }
+  fprintf( fp, "\n");
+  fprintf( fp, "typedef struct tag%s_GPIO_DEBOUNCE {\n", PREFIX );
+  fprintf( fp, "  uint32_t state[5];  // debounced logical levels, 1 = on\n");
+  fprintf( fp, "  uint32_t cnt0[5];   // vertical counter, low bitplane\n");
+  fprintf( fp, "  uint32_t cnt1[5];   // vertical counter, high bitplane\n");
+  fprintf( fp, "  uint32_t rose[5];   // turned on during the last tick\n");
+  fprintf( fp, "  uint32_t fell[5];   // turned off during the last tick\n");
+  fprintf( fp, "} %s_GPIO_DEBOUNCE;\n", PREFIX );
+  fprintf( fp, "extern %s_GPIO_DEBOUNCE %s_gpio_debounce;\n", PREFIX, prefix );
+  fprintf( fp, "extern void %s_gpio_debounce_init( void );\n", prefix );
+  fprintf( fp, "extern void %s_gpio_debounce_tick( void );\n", prefix );
+  fprintf( fp, "\n");
+  for(i=0;i<nseqs;i++) {
+    if(!pins[i].debounce) continue;
+    sprintf( temp, "%s_DB_%s", PREFIX, pins[i].signame );
+    fprintf( fp, "#define %-36s ((%s_gpio_debounce.state[%d] >> %d) & 1)\n", temp, prefix, pins[i].port, pins[i].bit );
+    sprintf( temp, "%s_DB_ROSE_%s", PREFIX, pins[i].signame );
+    fprintf( fp, "#define %-36s ((%s_gpio_debounce.rose[%d] >> %d) & 1)\n", temp, prefix, pins[i].port, pins[i].bit );
+    sprintf( temp, "%s_DB_FELL_%s", PREFIX, pins[i].signame );
+    fprintf( fp, "#define %-36s ((%s_gpio_debounce.fell[%d] >> %d) & 1)\n", temp, prefix, pins[i].port, pins[i].bit );
+  }
+  fprintf( fp, "\n");
+}
+
+void print_debounce_c( FILE *fp ) {
+  int port;
+  char db[MAXCHARS];
+  sprintf( db, "%s_gpio_debounce", prefix );
+  fprintf( fp, "\n");
+  fprintf( fp, "%s_GPIO_DEBOUNCE %s;\n", PREFIX, db );
+  fprintf( fp, "\n");
+  fprintf( fp, "void %s_gpio_debounce_init( void ) {\n", prefix );
+  for(port=0;port<5;port++) {
+    if(0==debounce_mask(port)) continue;
+    fprintf( fp, "  %s.state[%d] = (LPC_GPIO%d->FIOPIN ^ 0x%08lxu) & %s_DEBOUNCE_MASK%d;\n",
+                       db, port, port, POLARITY[port], PREFIX, port );
+    fprintf( fp, "  %s.cnt0[%d] = 0;\n", db, port );
+    fprintf( fp, "  %s.cnt1[%d] = 0;\n", db, port );
+    fprintf( fp, "  %s.rose[%d] = 0;\n", db, port );
+    fprintf( fp, "  %s.fell[%d] = 0;\n", db, port );
+  }
+  fprintf( fp, "}\n");
+  fprintf( fp, "\n");
+  fprintf( fp, "void %s_gpio_debounce_tick( void ) {\n", prefix );
+  fprintf( fp, "  uint32_t delta, toggle;\n");
+  for(port=0;port<5;port++) {
+    if(0==debounce_mask(port)) continue;
+    fprintf( fp, "  delta = ((LPC_GPIO%d->FIOPIN ^ 0x%08lxu) & %s_DEBOUNCE_MASK%d) ^ %s.state[%d];\n",
+                       port, POLARITY[port], PREFIX, port, db, port );
+    fprintf( fp, "  %s.cnt1[%d] = (%s.cnt1[%d] ^ %s.cnt0[%d]) & delta;\n", db, port, db, port, db, port );
+    fprintf( fp, "  %s.cnt0[%d] = ~%s.cnt0[%d] & delta;\n", db, port, db, port );
+    fprintf( fp, "  toggle = delta & ~(%s.cnt0[%d] | %s.cnt1[%d]);\n", db, port, db, port );
+    fprintf( fp, "  %s.state[%d] ^= toggle;\n", db, port );
+    fprintf( fp, "  %s.rose[%d] = toggle & %s.state[%d];\n", db, port, db, port );
+    fprintf( fp, "  %s.fell[%d] = toggle & ~%s.state[%d];\n", db, port, db, port );
+  }
+  fprintf( fp, "}\n");
+}
+
+
+//************************************************************************
+// C++ typed pin templates
+//************************************************************************
+// Every signal becomes a type, Pin<PortN, bit, ActiveHigh/ActiveLow>,
+// whose members are static inline and fold down to the same single
+// FIOSET/FIOCLR store or FIOPIN load as the C macros.  Because a pin is
+// a type rather than a macro, drivers can be templates over their pins
+// and the compiler still sees every address and mask as a constant.
+void print_cpp_hpp( FILE *fp ) {
+  int i, port;
+  fprintf( fp, "#ifndef %s_GPIO_HPP\n", PREFIX );
+  fprintf( fp, "#define %s_GPIO_HPP\n", PREFIX );
+  fprintf( fp, "\n");
+  fprintf( fp, "#include <stdint.h>\n");
+  fprintf( fp, "#include \"LPC17xx.h\"\n");
+  fprintf( fp, "\n");
+  fprintf( fp, "namespace %s {\n", prefix );
+  fprintf( fp, "\n");
+  fprintf( fp, "struct ActiveHigh { static constexpr bool active_low = false; };\n");
+  fprintf( fp, "struct ActiveLow  { static constexpr bool active_low = true; };\n");
+  fprintf( fp, "\n");
+  fprintf( fp, "template<int N> struct Port;\n");
+  for(port=0;port<5;port++) {
+    fprintf( fp, "template<> struct Port<%d> {\n", port );
+    fprintf( fp, "  static constexpr int index = %d;\n", port );
+    fprintf( fp, "  static inline LPC_GPIO_TypeDef *regs() { return LPC_GPIO%d; }\n", port );
+    fprintf( fp, "};\n");
+  }
+  for(port=0;port<5;port++) {
+    fprintf( fp, "typedef Port<%d> Port%d;\n", port, port );
+  }
+  fprintf( fp, "\n");
+  fprintf( fp, "template<typename P, int BIT, typename POL = ActiveHigh>\n");
+  fprintf( fp, "struct Pin {\n");
+  fprintf( fp, "  typedef P port;\n");
+  fprintf( fp, "  static constexpr int bit = BIT;\n");
+  fprintf( fp, "  static constexpr uint32_t mask = 1UL << BIT;\n");
+  fprintf( fp, "  static constexpr bool active_low = POL::active_low;\n");
+  fprintf( fp, "\n");
+  fprintf( fp, "  static inline void set()   { P::regs()->FIOSET = mask; }\n");
+  fprintf( fp, "  static inline void clear() { P::regs()->FIOCLR = mask; }\n");
+  fprintf( fp, "  static inline bool read()  { return (P::regs()->FIOPIN & mask) != 0; }\n");
+  fprintf( fp, "  static inline void on()    { if(active_low) clear(); else set(); }\n");
+  fprintf( fp, "  static inline void off()   { if(active_low) set(); else clear(); }\n");
+  fprintf( fp, "  static inline bool is_on() { return read() != active_low; }\n");
+  fprintf( fp, "  static inline void write( bool v ) { if(v) on(); else off(); }\n");
+  fprintf( fp, "  static inline void output() { P::regs()->FIODIR |= mask; }\n");
+  fprintf( fp, "  static inline void input()  { P::regs()->FIODIR &= ~mask; }\n");
+  fprintf( fp, "};\n");
+  fprintf( fp, "\n");
+  print_cpp_pinset( fp );
+  for(i=0;i<nseqs;i++) {
+    fprintf( fp, "typedef Pin<Port%d, %2d, %-10s> %s;\n", pins[i].port, pins[i].bit,
+                       (pins[i].active==0) ? "ActiveLow" : "ActiveHigh", pins[i].signame );
+  }
+  fprintf( fp, "\n");
+  fprintf( fp, "} // namespace %s\n", prefix );
+  fprintf( fp, "\n");
+  fprintf( fp, "#endif // %s_GPIO_HPP\n", PREFIX );
+}
+
+
+// PinSet<Pins...> folds any number of pins into one FIOSET and/or one
+// FIOCLR store per port that has members.  The per-port masks are
+// built by template recursion, so they are compile-time constants and
+// ports without members produce no code at all.  write(v) takes logical
+// values, bit i for the i-th pin in the list.
+void print_cpp_pinset( FILE *fp ) {
+  int port;
+  fprintf( fp, "// per-port masks of a pin list: all members, and the active-low ones\n");
+  fprintf( fp, "template<int N, typename... Ps> struct PortBits {\n");
+  fprintf( fp, "  static constexpr uint32_t all = 0;\n");
+  fprintf( fp, "  static constexpr uint32_t low = 0;\n");
+  fprintf( fp, "};\n");
+  fprintf( fp, "template<int N, typename P, typename... Rest> struct PortBits<N, P, Rest...> {\n");
+  fprintf( fp, "  static constexpr uint32_t all = (P::port::index == N ? P::mask : 0) |\n");
+  fprintf( fp, "                                  PortBits<N, Rest...>::all;\n");
+  fprintf( fp, "  static constexpr uint32_t low = (P::port::index == N && P::active_low ? P::mask : 0) |\n");
+  fprintf( fp, "                                  PortBits<N, Rest...>::low;\n");
+  fprintf( fp, "};\n");
+  fprintf( fp, "\n");
+  fprintf( fp, "// moves value bit I (I-th pin in the list) to its port bit position\n");
+  fprintf( fp, "template<int N, int I, typename... Ps> struct PortGather {\n");
+  fprintf( fp, "  static inline uint32_t get( uint32_t ) { return 0; }\n");
+  fprintf( fp, "};\n");
+  fprintf( fp, "template<int N, int I, typename P, typename... Rest> struct PortGather<N, I, P, Rest...> {\n");
+  fprintf( fp, "  static inline uint32_t get( uint32_t v ) {\n");
+  fprintf( fp, "    return (P::port::index == N ? ((v >> I) & 1UL) << P::bit : 0) |\n");
+  fprintf( fp, "           PortGather<N, I+1, Rest...>::get( v );\n");
+  fprintf( fp, "  }\n");
+  fprintf( fp, "};\n");
+  fprintf( fp, "\n");
+  fprintf( fp, "template<typename... Pins>\n");
+  fprintf( fp, "struct PinSet {\n");
+  fprintf( fp, "  static_assert(sizeof...(Pins) <= 32, \"PinSet holds at most 32 pins\");\n");
+  fprintf( fp, "\n");
+  fprintf( fp, "  template<int N> static inline void store( uint32_t setm, uint32_t clrm ) {\n");
+  fprintf( fp, "    if(setm) Port<N>::regs()->FIOSET = setm;\n");
+  fprintf( fp, "    if(clrm) Port<N>::regs()->FIOCLR = clrm;\n");
+  fprintf( fp, "  }\n");
+  fprintf( fp, "  template<int N> static inline void put( uint32_t v ) {\n");
+  fprintf( fp, "    if(PortBits<N, Pins...>::all) {\n");
+  fprintf( fp, "      uint32_t phys = PortGather<N, 0, Pins...>::get( v ) ^ PortBits<N, Pins...>::low;\n");
+  fprintf( fp, "      Port<N>::regs()->FIOSET =  phys & PortBits<N, Pins...>::all;\n");
+  fprintf( fp, "      Port<N>::regs()->FIOCLR = ~phys & PortBits<N, Pins...>::all;\n");
+  fprintf( fp, "    }\n");
+  fprintf( fp, "  }\n");
+  fprintf( fp, "\n");
+  fprintf( fp, "  static inline void set() {\n");
+  for(port=0;port<5;port++) {
+    fprintf( fp, "    store<%d>( PortBits<%d, Pins...>::all, 0 );\n", port, port );
+  }
+  fprintf( fp, "  }\n");
+  fprintf( fp, "  static inline void clear() {\n");
+  for(port=0;port<5;port++) {
+    fprintf( fp, "    store<%d>( 0, PortBits<%d, Pins...>::all );\n", port, port );
+  }
+  fprintf( fp, "  }\n");
+  fprintf( fp, "  static inline void on() {\n");
+  for(port=0;port<5;port++) {
+    fprintf( fp, "    store<%d>( PortBits<%d, Pins...>::all & ~PortBits<%d, Pins...>::low, PortBits<%d, Pins...>::low );\n",
+                       port, port, port, port );
+  }
+  fprintf( fp, "  }\n");
+  fprintf( fp, "  static inline void off() {\n");
+  for(port=0;port<5;port++) {
+    fprintf( fp, "    store<%d>( PortBits<%d, Pins...>::low, PortBits<%d, Pins...>::all & ~PortBits<%d, Pins...>::low );\n",
+                       port, port, port, port );
+  }
+  fprintf( fp, "  }\n");
+  fprintf( fp, "  static inline void write( uint32_t v ) {\n");
+  for(port=0;port<5;port++) {
+    fprintf( fp, "    put<%d>( v );\n", port );
+  }
+  fprintf( fp, "  }\n");
+  fprintf( fp, "};\n");
+  fprintf( fp, "\n");
+}
+
+
+//************************************************************************
+// Runtime-loadable configuration blob
+//************************************************************************
+// One firmware image can carry a blob per board variant and pick one at
+// boot (from strap pins, say).  The blob is little-endian 32-bit words:
+//   header    magic, version<<16 | nsignals, length in bytes, CRC-32
+//   registers PINSEL0..10, PINMODE0..9, PINMODE_OD0..4,
+//             FIODIR0..4, FIOPIN0..4, FIOMASK0..4
+//   signals   one word each, in CSV order: port | bit<<8 | func<<16 | flags<<24
+// The CRC (IEEE 802.3, as zlib) covers everything after the header.
+#define BLOB_MAGIC     (0x4e49505aUL)  // "ZPIN"
+#define BLOB_VERSION   (1)
+#define BLOB_HDR_WORDS (4)
+#define BLOB_REG_WORDS (11+10+5+5+5+5)
+#define MAXBLOB (BLOB_HDR_WORDS+BLOB_REG_WORDS+MAXPINS)
+unsigned long blob[MAXBLOB];
+int blob_nwords;
+
+unsigned long crc32_update( unsigned long crc, const unsigned char *p, int n ) {
+  int i, k;
+  crc = ~crc & 0xffffffffUL;
+  for(i=0;i<n;i++) {
+    crc ^= p[i];
+    for(k=0;k<8;k++) crc = (crc>>1) ^ ((crc&1) ? 0xedb88320UL : 0);
+  }
+  return ~crc & 0xffffffffUL;
+}
+
+void build_blob( void ) {
+  int i, n;
+  unsigned char bytes[4];
+  unsigned long crc;
+
+  n=BLOB_HDR_WORDS;
+  for(i=0;i<11;i++) blob[n++]=PINSEL[i];
+  for(i=0;i<10;i++) blob[n++]=PINMODE[i];
+  for(i=0;i<5;i++)  blob[n++]=PINMODE_OD[i];
+  for(i=0;i<5;i++)  blob[n++]=FIODIR[i];
+  for(i=0;i<5;i++)  blob[n++]=FIOPIN[i];
+  for(i=0;i<5;i++)  blob[n++]=FIOMASK[i];
+  for(i=0;i<nseqs;i++) {
+    blob[n++] = (pins[i].port & 0xff) | ((pins[i].bit & 0xff)<<8) |
+                ((pins[i].func & 0xff)<<16) | ((unsigned long)pin_flags(&pins[i])<<24);
+  }
+  blob_nwords=n;
+
+  crc=0;
+  for(i=BLOB_HDR_WORDS;i<n;i++) {
+    bytes[0]=blob[i]; bytes[1]=blob[i]>>8; bytes[2]=blob[i]>>16; bytes[3]=blob[i]>>24;
+    crc=crc32_update( crc, bytes, 4 );
+  }
+  blob[0]=BLOB_MAGIC;
+  blob[1]=((unsigned long)BLOB_VERSION<<16) | nseqs;
+  blob[2]=4*n;
+  blob[3]=crc;
+}
+
+void print_blob_h( FILE *fp ) {
+  fprintf( fp, "#define %s_BLOB_MAGIC      (0x%08lxu)\n", PREFIX, BLOB_MAGIC );
+  fprintf( fp, "#define %s_BLOB_VERSION    (%d)\n", PREFIX, BLOB_VERSION );
+  fprintf( fp, "#define %s_BLOB_HDR_WORDS  (%d)\n", PREFIX, BLOB_HDR_WORDS );
+  fprintf( fp, "#define %s_BLOB_REG_WORDS  (%d)\n", PREFIX, BLOB_REG_WORDS );
+  fprintf( fp, "// register image offsets, in words after the header\n");
+  fprintf( fp, "#define %s_BLOB_PINSEL     (0)   // PINSEL0..10\n", PREFIX );
+  fprintf( fp, "#define %s_BLOB_PINMODE    (11)  // PINMODE0..9, PINMODE_OD0..4\n", PREFIX );
+  fprintf( fp, "#define %s_BLOB_FIODIR     (26)\n", PREFIX );
+  fprintf( fp, "#define %s_BLOB_FIOPIN     (31)\n", PREFIX );
+  fprintf( fp, "#define %s_BLOB_FIOMASK    (36)\n", PREFIX );
+  fprintf( fp, "#define %s_BLOB_NSIGNALS(b)   ((b)[1] & 0xffff)\n", PREFIX );
+  fprintf( fp, "#define %s_BLOB_SIGNAL(b,i)   ((b)[%s_BLOB_HDR_WORDS+%s_BLOB_REG_WORDS+(i)])\n", PREFIX, PREFIX, PREFIX );
+  fprintf( fp, "#define %s_BLOB_SIG_PORT(e)   ((e) & 0xff)\n", PREFIX );
+  fprintf( fp, "#define %s_BLOB_SIG_BIT(e)    (((e) >> 8) & 0xff)\n", PREFIX );
+  fprintf( fp, "#define %s_BLOB_SIG_FUNC(e)   (((e) >> 16) & 0xff)\n", PREFIX );
+  fprintf( fp, "#define %s_BLOB_SIG_FLAGS(e)  (((e) >> 24) & 0xff)  // PF_ bits as in -compact\n", PREFIX );
+  fprintf( fp, "#define %s_BLOB_OK         (0)\n", PREFIX );
+  fprintf( fp, "#define %s_BLOB_EMAGIC     (-1)\n", PREFIX );
+  fprintf( fp, "#define %s_BLOB_EVERSION   (-2)\n", PREFIX );
+  fprintf( fp, "#define %s_BLOB_ELENGTH    (-3)\n", PREFIX );
+  fprintf( fp, "#define %s_BLOB_ECRC       (-4)\n", PREFIX );
+  fprintf( fp, "extern int %s_gpio_blob_check( const uint32_t *blob );\n", prefix );
+  fprintf( fp, "extern int %s_gpio_blob_apply( const uint32_t *blob );\n", prefix );
+  fprintf( fp, "// each blob is declared in its own %s_gpio_blob_<variant>.h\n", prefix );
+  fprintf( fp, "\n");
+}
+
+// The applier is the same for every variant.  CRC uses a 16-entry table,
+// two lookups per byte; registers are written latches first and PINSEL
+// last, so no pin is driven before its level and mode are in place.
+void print_blob_c( FILE *fp ) {
+  int i, k;
+  unsigned long crc;
+  fprintf( fp, "\n");
+  fprintf( fp, "static const uint32_t %s_blob_crc_nibble[16] = {\n", prefix );
+  for(i=0;i<16;i++) {
+    // CRC register after shifting in nibble i on its own
+    crc=i;
+    for(k=0;k<4;k++) crc = (crc>>1) ^ ((crc&1) ? 0xedb88320UL : 0);
+    fprintf( fp, "%s0x%08lxu%s", (i%4) ? " " : "  ", crc, (i==15) ? "\n" : ((i%4)==3) ? ",\n" : "," );
+  }
+  fprintf( fp, "};\n");
+  fprintf( fp, "\n");
+  fprintf( fp, "int %s_gpio_blob_check( const uint32_t *blob ) {\n", prefix );
+  fprintf( fp, "  const uint8_t *p;\n");
+  fprintf( fp, "  uint32_t crc, n, nwords;\n");
+  fprintf( fp, "  if(blob[0] != %s_BLOB_MAGIC) return %s_BLOB_EMAGIC;\n", PREFIX, PREFIX );
+  fprintf( fp, "  if((blob[1] >> 16) != %s_BLOB_VERSION) return %s_BLOB_EVERSION;\n", PREFIX, PREFIX );
+  fprintf( fp, "  nwords = %s_BLOB_HDR_WORDS + %s_BLOB_REG_WORDS + %s_BLOB_NSIGNALS(blob);\n", PREFIX, PREFIX, PREFIX );
+  fprintf( fp, "  if(blob[2] != 4*nwords) return %s_BLOB_ELENGTH;\n", PREFIX );
+  fprintf( fp, "  p = (const uint8_t *)&blob[%s_BLOB_HDR_WORDS];\n", PREFIX );
+  fprintf( fp, "  crc = 0xffffffffu;\n");
+  fprintf( fp, "  for(n=4*(nwords-%s_BLOB_HDR_WORDS);n;n--) {\n", PREFIX );
+  fprintf( fp, "    crc ^= *p++;\n");
+  fprintf( fp, "    crc = (crc >> 4) ^ %s_blob_crc_nibble[crc & 15];\n", prefix );
+  fprintf( fp, "    crc = (crc >> 4) ^ %s_blob_crc_nibble[crc & 15];\n", prefix );
+  fprintf( fp, "  }\n");
+  fprintf( fp, "  if(~crc != blob[3]) return %s_BLOB_ECRC;\n", PREFIX );
+  fprintf( fp, "  return %s_BLOB_OK;\n", PREFIX );
+  fprintf( fp, "}\n");
+  fprintf( fp, "\n");
+  fprintf( fp, "int %s_gpio_blob_apply( const uint32_t *blob ) {\n", prefix );
+  fprintf( fp, "  const uint32_t *r;\n");
+  fprintf( fp, "  int err, i;\n");
+  fprintf( fp, "  err = %s_gpio_blob_check( blob );\n", prefix );
+  fprintf( fp, "  if(err) return err;\n");
+  fprintf( fp, "  r = &blob[%s_BLOB_HDR_WORDS];\n", PREFIX );
+  for(i=0;i<5;i++) {
+    fprintf( fp, "  LPC_GPIO%d->FIOMASK = 0; LPC_GPIO%d->FIOPIN = r[%s_BLOB_FIOPIN+%d];\n", i, i, PREFIX, i );
+  }
+  fprintf( fp, "  for(i=0;i<15;i++) (&LPC_PINCON->PINMODE0)[i] = r[%s_BLOB_PINMODE+i];  // and PINMODE_OD\n", PREFIX );
+  for(i=0;i<5;i++) {
+    fprintf( fp, "  LPC_GPIO%d->FIODIR = r[%s_BLOB_FIODIR+%d];\n", i, PREFIX, i );
+  }
+  fprintf( fp, "  for(i=0;i<11;i++) (&LPC_PINCON->PINSEL0)[i] = r[%s_BLOB_PINSEL+i];\n", PREFIX );
+  for(i=0;i<5;i++) {
+    fprintf( fp, "  LPC_GPIO%d->FIOMASK = r[%s_BLOB_FIOMASK+%d];\n", i, PREFIX, i );
+  }
+  fprintf( fp, "  return %s_BLOB_OK;\n", PREFIX );
+  fprintf( fp, "}\n");
+}
+
+// one header per variant, so a build linking several blobs sees them all
+void print_blob_data_h( FILE *fp ) {
+  int i;
+  char guard[MAXCHARS];
+  for(i=0;blob_variant[i];i++) guard[i]=toupper(blob_variant[i]);
+  guard[i]=0;
+  fprintf( fp, "#ifndef %s_GPIO_BLOB_%s_H\n", PREFIX, guard );
+  fprintf( fp, "#define %s_GPIO_BLOB_%s_H\n", PREFIX, guard );
+  fprintf( fp, "#include <stdint.h>\n");
+  fprintf( fp, "extern const uint32_t %s_gpio_blob_%s[%d];\n", prefix, blob_variant, blob_nwords );
+  fprintf( fp, "#endif\n");
+}
+
+void print_blob_data_c( FILE *fp ) {
+  int i;
+  fprintf( fp, "#include <stdint.h>\n");
+  fprintf( fp, "#include \"%s\"\n", fname_out_blob_h );
+  fprintf( fp, "\n");
+  fprintf( fp, "// board variant %s: %d signals, %d bytes, CRC-32 0x%08lx\n",
+                     blob_variant, nseqs, 4*blob_nwords, blob[3] );
+  fprintf( fp, "const uint32_t %s_gpio_blob_%s[%d] = {\n", prefix, blob_variant, blob_nwords );
+  for(i=0;i<blob_nwords;i++) {
+    fprintf( fp, "%s0x%08lx%s", (i%6) ? " " : "  ", blob[i],
+                       (i==blob_nwords-1) ? "\n" : ((i%6)==5) ? ",\n" : "," );
+  }
+  fprintf( fp, "};\n");
+}
+
+void write_blob_bin( FILE *fp ) {
+  int i;
+  for(i=0;i<blob_nwords;i++) {
+    fputc( blob[i] & 0xff, fp );
+    fputc( (blob[i]>>8) & 0xff, fp );
+    fputc( (blob[i]>>16) & 0xff, fp );
+    fputc( (blob[i]>>24) & 0xff, fp );
+  }
+}
+
+
+//************************************************************************
+// Cortex-M3 bit-band aliases
+//************************************************************************
+// Each bit in the two 1 MB bit-band regions has its own word address in
+// the matching 32 MB alias region: reading it returns 0 or 1, writing it
+// changes only that bit as a single locked bus transaction.  Note the
+// LPC17xx GPIO block sits at 0x2009C000, inside the SRAM bit-band region
+// (alias 0x22000000), while PINCON is in the peripheral region (alias
+// 0x42000000).
+#define GPIO_BASE       (0x2009C000UL)
+#define GPIO_PORT_SIZE  (0x20UL)
+#define FIODIR_OFFSET   (0x00UL)
+#define FIOPIN_OFFSET   (0x14UL)
+#define PINCON_BASE     (0x4002C000UL)
+#define PINMODE_OD_OFFSET (0x68UL)
+
+unsigned long bitband_alias( unsigned long addr, int bit ) {
+  unsigned long region, alias;
+  region = addr & 0xF0000000UL; // 0x20000000 (SRAM) or 0x40000000 (peripheral)
+  alias = region + 0x02000000UL;
+  return alias + ((addr - region) << 5) + ((unsigned long)bit << 2);
+}
+
+// the word at a bit-band alias; with -sim it goes through PREFIX_BB_WORD
+// so the simulator can map it back onto the register
+void bb_word( char *out, unsigned long alias ) {
+  if(opt_sim) sprintf( out, "%s_BB_WORD(0x%08lx)", PREFIX, alias );
+  else        sprintf( out, "*(volatile uint32_t *)0x%08lx", alias );
+}
+
+void print_bitband_defines( FILE *fp ) {
+  int i;
+  unsigned long gpio;
+  char temp[MAXCHARS];
+  char word[MAXCHARS];
+
+  if(opt_sim) {
+    fprintf( fp, "#ifndef %s_BB_WORD\n", PREFIX );
+    fprintf( fp, "#define %s_BB_WORD(a) (*(volatile uint32_t *)(a))\n", PREFIX );
+    fprintf( fp, "#endif\n");
+  }
+  for(i=0;i<nseqs;i++) {
+    gpio = GPIO_BASE + pins[i].port*GPIO_PORT_SIZE;
+    sprintf( temp, "%s_BB_PIN_%s", PREFIX, pins[i].signame );
+    bb_word( word, bitband_alias( gpio + FIOPIN_OFFSET, pins[i].bit ) );
+    fprintf( fp, "#define %-32s    (%s)\n", temp, word );
+    sprintf( temp, "%s_BB_DIR_%s", PREFIX, pins[i].signame );
+    bb_word( word, bitband_alias( gpio + FIODIR_OFFSET, pins[i].bit ) );
+    fprintf( fp, "#define %-32s    (%s)\n", temp, word );
+    sprintf( temp, "%s_BB_OD_%s", PREFIX, pins[i].signame );
+    bb_word( word, bitband_alias( PINCON_BASE + PINMODE_OD_OFFSET + 4*pins[i].port, pins[i].bit ) );
+    fprintf( fp, "#define %-32s    (%s)\n", temp, word );
+  }
+  fprintf( fp, "\n");
+
+  for(i=0;i<nseqs;i++) {
+    fprintf( fp, "#define %s_DIR_OUT_%-25s (%s_BB_DIR_%s = 1)\n", 
+                        PREFIX, pins[i].signame, PREFIX, pins[i].signame );
+    fprintf( fp, "#define %s_DIR_IN_%-25s  (%s_BB_DIR_%s = 0)\n", 
+                        PREFIX, pins[i].signame, PREFIX, pins[i].signame );
+    fprintf( fp, "#define %s_OD_ON_%-25s   (%s_BB_OD_%s = 1)\n", 
+                        PREFIX, pins[i].signame, PREFIX, pins[i].signame );
+    fprintf( fp, "#define %s_OD_OFF_%-25s  (%s_BB_OD_%s = 0)\n", 
+                        PREFIX, pins[i].signame, PREFIX, pins[i].signame );
+  }
+  fprintf( fp, "\n");
+}
+
+
+//************************************************************************
+// Pin-mux switching
+//************************************************************************
+// For every signal, one routine per function it can take: GPIO plus
+// each of FUNC1..3 that is not blank or N/A.  The PINSEL register, mask
+// and value are constants, so a switch is a single read-modify-write of
+// one PINSEL word.  With -bitband it is instead one alias store per
+// bit that can differ, with no read, where that can't briefly select
+// an unrelated function (see mux_alias_bits).
+// PINMODE is left as the CSV sets it.
+#define PINSEL_OFFSET   (0x00UL)
+
+// identifier-safe name of a pin function, false if the pin lacks it
+bool mux_name( PINDEF *pd, int func, char *name ) {
+  char *src, *dst;
+  if(func==0) {
+    strcpy( name, "GPIO" );
+    return true;
+  }
+  if(func==1) src=pd->altfunc1;
+  else if(func==2) src=pd->altfunc2;
+  else src=pd->altfunc3;
+  if((strlen(src)==0) || (0==strncmp(src,"N/A",3))) return false;
+  for(dst=name;*src && (dst-name<MAXCHARS-1);src++) {
+    *dst++ = isalnum(*src) ? toupper(*src) : '_';
+  }
+  *dst=0;
+  return true;
+}
+
+void print_mux_h( FILE *fp ) {
+  int i, func, reg, bit2;
+  char name[MAXCHARS];
+  char temp[MAXCHARS];
+  for(i=0;i<nseqs;i++) {
+    if((pins[i].port>4) || (pins[i].bit>31)) continue;
+    reg = pins[i].port*2 + pins[i].bit/16;
+    bit2 = 2*(pins[i].bit%16);
+    sprintf( temp, "%s_MUX_%s_REG", PREFIX, pins[i].signame );
+    fprintf( fp, "#define %-40s (%d)  // PINSEL%d\n", temp, reg, reg );
+    sprintf( temp, "%s_MUX_%s_MASK", PREFIX, pins[i].signame );
+    fprintf( fp, "#define %-40s (0x%08lx)\n", temp, 0x03UL<<bit2 );
+    for(func=0;func<4;func++) {
+      if(!mux_name( &pins[i], func, name )) continue;
+      sprintf( temp, "%s_MUX_%s_%s", PREFIX, pins[i].signame, name );
+      fprintf( fp, "#define %-40s (0x%08lx)\n", temp, (unsigned long)func<<bit2 );
+    }
+    for(func=0;func<4;func++) {
+      if(!mux_name( &pins[i], func, name )) continue;
+      fprintf( fp, "extern void %s_gpio_mux_%s_%s( void );\n", prefix, pins[i].signame, name );
+    }
+  }
+  fprintf( fp, "\n");
+}
+
+// PINSEL bits that bit-band stores must write to reach func, or -1 if
+// they can't do it glitch-free.  Two alias stores pass through the
+// function between source and target, so every function the pin can be
+// in (any mux target, its FUNC and SLEEP_FUNC) must differ from func in
+// at most one bit; then the intermediate is the source or the target.
+int mux_alias_bits( PINDEF *pd, int func ) {
+  int f, d, bits=0;
+  char name[MAXCHARS];
+  for(f=0;f<4;f++) {
+    if(!mux_name( pd, f, name ) && (f!=pd->func) && (f!=pd->sleep_func)) continue;
+    d=f^func;
+    if(d==3) return -1;
+    bits|=d;
+  }
+  return bits;
+}
+
+void print_mux_c( FILE *fp ) {
+  int i, func, reg, bit2, diff, b;
+  unsigned long addr;
+  char name[MAXCHARS];
+  char word[MAXCHARS];
+  fprintf( fp, "\n");
+  for(i=0;i<nseqs;i++) {
+    if((pins[i].port>4) || (pins[i].bit>31)) continue;
+    reg = pins[i].port*2 + pins[i].bit/16;
+    bit2 = 2*(pins[i].bit%16);
+    addr = PINCON_BASE + PINSEL_OFFSET + 4*reg;
+    for(func=0;func<4;func++) {
+      if(!mux_name( &pins[i], func, name )) continue;
+      fprintf( fp, "void %s_gpio_mux_%s_%s( void ) {\n", prefix, pins[i].signame, name );
+      diff=mux_alias_bits( &pins[i], func );
+      if(opt_bitband && (diff>=0)) {
+        for(b=0;b<2;b++) {
+          if(!(diff & (1<<b))) continue;
+          bb_word( word, bitband_alias( addr, bit2+b ) );
+          fprintf( fp, "  %s = %d;\n", word, (func>>b) & 1 );
+        }
+      } else {
+        fprintf( fp, "  LPC_PINCON->PINSEL%d = (LPC_PINCON->PINSEL%d & ~0x%08lxu) | 0x%08lxu;\n",
+                           reg, reg, 0x03UL<<bit2, (unsigned long)func<<bit2 );
+      }
+      fprintf( fp, "}\n");
+    }
+  }
+}
+
+
+//************************************************************************
+// Software buses
+//************************************************************************
+// A SOFTBUS column of BUS:ROLE (SPI roles CLK, MOSI, MISO, CS; I2C roles
+// SDA, SCL) collects GPIO pins into a bit-banged bus.  The routines are
+// unrolled for the exact port and bit of every line, so each shift and
+// mask is a constant and no pin table is consulted.  SPI is mode 0, MSB
+// first; where CLK and MOSI share a port the falling clock edge and a
+// MOSI clear go out in one FIOCLR store.  I2C lines are driven low with
+// FIOCLR and released with FIOSET, so they want OD set; SDA and SCL are
+// always written separately to keep SDA from moving while SCL is high.
+// There is no clock stretching.  With -bitband, MISO and SDA are read
+// through their alias word, and MOSI written through it unless an
+// open-drain output shares its port (the alias write is a read-modify-
+// write of FIOPIN, which would latch a low read back from such a pin).
+// Each routine's comment gives its register accesses next to those of
+// the usual generic driver, whose pins are port/bit table entries read
+// on every access, digitalWrite() style: two table reads (entry and port
+// base, one if the pin is not connected) and one FIOSET or FIOCLR store
+// or FIOPIN load per pin access, with a branch per data bit.
+const char *sb_role_name[SB_NROLES] = { "CLK", "MOSI", "MISO", "CS", "SDA", "SCL" };
+
+void calc_softbus( void ) {
+  int i, j, role;
+  char bus[MAXCHARS];
+  char *cp;
+  SOFTBUSDEF *sb;
+
+  nsoftbus=0;
+  for(i=0;i<nseqs;i++) {
+    if(strlen(pins[i].softbus)==0) continue;
+    strncpy(bus,pins[i].softbus,MAXCHARS);
+    for(cp=bus;*cp;cp++) *cp=toupper(*cp);
+    cp=strchr(bus,':');
+    if(cp==NULL) {
+      fprintf(stderr,"Warning: %s: SOFTBUS %s is not BUS:ROLE, ignored\n", pins[i].signame, bus );
+      continue;
+    }
+    *cp++=0;
+    trim_trail(bus);
+    cp=trim_lead(cp);
+    for(role=0;role<SB_NROLES;role++) {
+      if(0==strcmp(cp,sb_role_name[role])) break;
+    }
+    if(role==SB_NROLES) {
+      fprintf(stderr,"Warning: %s: unknown SOFTBUS role %s, ignored\n", pins[i].signame, cp );
+      continue;
+    }
+    for(j=0;j<nsoftbus;j++) {
+      if(0==strcmp(softbus[j].name,bus)) break;
+    }
+    sb=&softbus[j];
+    if(j==nsoftbus) {
+      if(nsoftbus>=MAXSOFTBUS) {
+        fprintf(stderr,"Warning: too many software buses, %s ignored\n", bus );
+        continue;
+      }
+      nsoftbus++;
+      strncpy(sb->name,bus,MAXCHARS);
+      for(j=0;j<SB_NROLES;j++) sb->pin[j]=-1;
+      sb->type=(role>=SB_SDA) ? SB_I2C : SB_SPI;
+      sb->valid=true;
+    }
+    if(sb->type != ((role>=SB_SDA) ? SB_I2C : SB_SPI)) {
+      fprintf(stderr,"Warning: softbus %s mixes SPI and I2C roles, bus skipped\n", sb->name );
+      sb->valid=false;
+    }
+    if(sb->pin[role]>=0) {
+      fprintf(stderr,"Warning: softbus %s has two %s pins, bus skipped\n", sb->name, sb_role_name[role] );
+      sb->valid=false;
+    }
+    if(pins[i].func!=0) {
+      fprintf(stderr,"Warning: softbus %s: %s is not a GPIO, bus skipped\n", sb->name, pins[i].signame );
+      sb->valid=false;
+    }
+    if((role==SB_MISO) && (pins[i].inout!=IN)) {
+      fprintf(stderr,"Warning: softbus %s: %s should be an input\n", sb->name, pins[i].signame );
+    }
+    if((role!=SB_MISO) && (pins[i].inout!=OUT)) {
+      fprintf(stderr,"Warning: softbus %s: %s should be an output\n", sb->name, pins[i].signame );
+    }
+    if((role>=SB_SDA) && !pins[i].odrain) {
+      fprintf(stderr,"Warning: softbus %s: %s is not open drain\n", sb->name, pins[i].signame );
+    }
+    sb->pin[role]=i;
+  }
+
+  for(j=0;j<nsoftbus;j++) {
+    sb=&softbus[j];
+    if(!sb->valid) continue;
+    if((sb->type==SB_SPI) && ((sb->pin[SB_CLK]<0) || ((sb->pin[SB_MOSI]<0) && (sb->pin[SB_MISO]<0)))) {
+      fprintf(stderr,"Warning: softbus %s needs CLK and MOSI or MISO, bus skipped\n", sb->name );
+      sb->valid=false;
+    }
+    if((sb->type==SB_I2C) && ((sb->pin[SB_SDA]<0) || (sb->pin[SB_SCL]<0))) {
+      fprintf(stderr,"Warning: softbus %s needs SDA and SCL, bus skipped\n", sb->name );
+      sb->valid=false;
+    }
+  }
+}
+
+bool any_softbus( void ) {
+  int j;
+  for(j=0;j<nsoftbus;j++) {
+    if(softbus[j].valid) return true;
+  }
+  return false;
+}
+
+bool any_softbus_type( int type ) {
+  int j;
+  for(j=0;j<nsoftbus;j++) {
+    if(softbus[j].valid && (softbus[j].type==type)) return true;
+  }
+  return false;
+}
+
+// bus name as an identifier, in upper or lower case
+void softbus_ident( char *out, SOFTBUSDEF *sb, bool upper ) {
+  char *cp;
+  for(cp=sb->name;*cp;cp++) {
+    if(!isalnum(*cp)) *out++='_';
+    else *out++ = upper ? toupper(*cp) : tolower(*cp);
+  }
+  *out=0;
+}
+
+unsigned long sb_mask( SOFTBUSDEF *sb, int role ) {
+  return 1UL<<pins[sb->pin[role]].bit;
+}
+
+int sb_port( SOFTBUSDEF *sb, int role ) {
+  return pins[sb->pin[role]].port;
+}
+
+// true if the alias write of role's FIOPIN bit can't clobber another pin
+bool sb_bitband_write( SOFTBUSDEF *sb, int role ) {
+  int i;
+  if(!opt_bitband) return false;
+  for(i=0;i<nseqs;i++) {
+    if((pins[i].port==sb_port(sb,role)) && (pins[i].func==0) &&
+       (pins[i].inout==OUT) && pins[i].odrain) return false;
+  }
+  return true;
+}
+
+// expression moving bit 'from' of val to bit 'to', masked to that bit
+void sb_shift( char *out, const char *val, int from, int to ) {
+  if(from>to)       sprintf( out, "(%s >> %d) & 0x%08lxu", val, from-to, 1UL<<to );
+  else if(from<to)  sprintf( out, "(%s << %d) & 0x%08lxu", val, to-from, 1UL<<to );
+  else              sprintf( out, "%s & 0x%08lxu", val, 1UL<<to );
+}
+
+// the same job done by the generic pin-table driver, for comparison
+void print_softbus_generic( FILE *fp, int nstores, int nloads, int nreads ) {
+  fprintf( fp, "// (generic pin-table driver: %d stores, %d load%s and %d table reads)\n",
+           nstores, nloads, (nloads==1) ? "" : "s", nreads );
+}
+
+// in gets bit 'b' from the role's pin
+void print_softbus_read( FILE *fp, SOFTBUSDEF *sb, int role, int b ) {
+  char temp[MAXCHARS];
+  char val[MAXCHARS];
+  if(opt_bitband) {
+    fprintf( fp, "  in = (in << 1) | %s_BB_PIN_%s;\n", PREFIX, pins[sb->pin[role]].signame );
+  } else {
+    sprintf( val, "LPC_GPIO%d->FIOPIN", sb_port(sb,role) );
+    sb_shift( temp, val, pins[sb->pin[role]].bit, b );
+    fprintf( fp, "  in |= %s;\n", temp );
+  }
+}
+
+void print_softbus_h( FILE *fp ) {
+  int j;
+  char BUS[MAXCHARS], bus[MAXCHARS], temp[MAXCHARS];
+  SOFTBUSDEF *sb;
+  for(j=0;j<nsoftbus;j++) {
+    sb=&softbus[j];
+    if(!sb->valid) continue;
+    softbus_ident( BUS, sb, true );
+    softbus_ident( bus, sb, false );
+    sprintf( temp, "%s_%s_DELAY()", PREFIX, BUS );
+    fprintf( fp, "#ifndef %s_%s_DELAY  // half bit time, empty runs flat out\n", PREFIX, BUS );
+    fprintf( fp, "#define %s\n", temp );
+    fprintf( fp, "#endif\n");
+    if(sb->type==SB_SPI) {
+      if(sb->pin[SB_CS]>=0) {
+        sprintf( temp, "%s_%s_SELECT", PREFIX, BUS );
+        fprintf( fp, "#define %-36s %s_ON_%s\n", temp, PREFIX, pins[sb->pin[SB_CS]].signame );
+        sprintf( temp, "%s_%s_DESELECT", PREFIX, BUS );
+        fprintf( fp, "#define %-36s %s_OFF_%s\n", temp, PREFIX, pins[sb->pin[SB_CS]].signame );
+      }
+      fprintf( fp, "extern uint8_t %s_gpio_%s_xfer( uint8_t out );\n", prefix, bus );
+    } else {
+      fprintf( fp, "extern void %s_gpio_%s_start( void );\n", prefix, bus );
+      fprintf( fp, "extern void %s_gpio_%s_stop( void );\n", prefix, bus );
+      fprintf( fp, "extern int %s_gpio_%s_write( uint8_t out );  // 0 if ACKed\n", prefix, bus );
+      fprintf( fp, "extern uint8_t %s_gpio_%s_read( int ack );\n", prefix, bus );
+    }
+    fprintf( fp, "\n");
+  }
+}
+
+void print_softbus_spi( FILE *fp, SOFTBUSDEF *sb, char *BUS, char *bus ) {
+  int b, pc, pm, nstores, nloads;
+  unsigned long clk, mosi;
+  bool bbw, same;
+  char temp[MAXCHARS];
+
+  pc=sb_port(sb,SB_CLK);
+  clk=sb_mask(sb,SB_CLK);
+  pm=(sb->pin[SB_MOSI]>=0) ? sb_port(sb,SB_MOSI) : -1;
+  mosi=(pm>=0) ? sb_mask(sb,SB_MOSI) : 0;
+  bbw=(pm>=0) && sb_bitband_write(sb,SB_MOSI);
+  same=(pm==pc) && !bbw;
+
+  nstores = 1 + 8*(2 + ((pm<0) ? 0 : ((same || bbw) ? 1 : 2)));
+  nloads = (sb->pin[SB_MISO]>=0) ? 8 : 0;
+  fprintf( fp, "\n");
+  fprintf( fp, "// %s: mode 0, MSB first, %d stores and %d loads per byte\n", sb->name, nstores, nloads );
+  print_softbus_generic( fp, 8*((pm<0) ? 2 : 3), nloads,
+                         8*(4 + ((pm<0) ? 1 : 2) + ((nloads==0) ? 1 : 2)) );
+  fprintf( fp, "uint8_t %s_gpio_%s_xfer( uint8_t out ) {\n", prefix, bus );
+  if((pm>=0) && !bbw) fprintf( fp, "  uint32_t v;\n");
+  fprintf( fp, "  uint32_t in = 0;\n");
+  for(b=7;b>=0;b--) {
+    if(pm<0) {
+      fprintf( fp, "  LPC_GPIO%d->FIOCLR = 0x%08lxu;\n", pc, clk );
+    } else if(bbw) {
+      fprintf( fp, "  LPC_GPIO%d->FIOCLR = 0x%08lxu;\n", pc, clk );
+      fprintf( fp, "  %s_BB_PIN_%s = (out >> %d) & 1;\n", PREFIX, pins[sb->pin[SB_MOSI]].signame, b );
+    } else {
+      sb_shift( temp, "(uint32_t)out", b, pins[sb->pin[SB_MOSI]].bit );
+      fprintf( fp, "  v = %s;\n", temp );
+      if(same) {
+        fprintf( fp, "  LPC_GPIO%d->FIOCLR = v ^ 0x%08lxu;\n", pc, clk|mosi );
+      } else {
+        fprintf( fp, "  LPC_GPIO%d->FIOCLR = 0x%08lxu;\n", pc, clk );
+        fprintf( fp, "  LPC_GPIO%d->FIOCLR = v ^ 0x%08lxu;\n", pm, mosi );
+      }
+      fprintf( fp, "  LPC_GPIO%d->FIOSET = v;\n", pm );
+    }
+    fprintf( fp, "  %s_%s_DELAY();\n", PREFIX, BUS );
+    fprintf( fp, "  LPC_GPIO%d->FIOSET = 0x%08lxu;\n", pc, clk );
+    if(sb->pin[SB_MISO]>=0) print_softbus_read( fp, sb, SB_MISO, b );
+    fprintf( fp, "  %s_%s_DELAY();\n", PREFIX, BUS );
+  }
+  fprintf( fp, "  LPC_GPIO%d->FIOCLR = 0x%08lxu;\n", pc, clk );
+  fprintf( fp, "  return in;\n");
+  fprintf( fp, "}\n");
+}
+
+void print_softbus_i2c( FILE *fp, SOFTBUSDEF *sb, char *BUS, char *bus ) {
+  int b, pd, pc;
+  unsigned long sda, scl;
+  char temp[MAXCHARS];
+
+  pd=sb_port(sb,SB_SDA);
+  sda=sb_mask(sb,SB_SDA);
+  pc=sb_port(sb,SB_SCL);
+  scl=sb_mask(sb,SB_SCL);
+
+  fprintf( fp, "\n");
+  fprintf( fp, "// %s: 4 stores\n", sb->name );
+  print_softbus_generic( fp, 4, 0, 8 );
+  fprintf( fp, "void %s_gpio_%s_start( void ) {\n", prefix, bus );
+  fprintf( fp, "  LPC_GPIO%d->FIOSET = 0x%08lxu;\n", pd, sda );
+  fprintf( fp, "  %s_%s_DELAY();\n", PREFIX, BUS );
+  fprintf( fp, "  LPC_GPIO%d->FIOSET = 0x%08lxu;\n", pc, scl );
+  fprintf( fp, "  %s_%s_DELAY();\n", PREFIX, BUS );
+  fprintf( fp, "  LPC_GPIO%d->FIOCLR = 0x%08lxu;\n", pd, sda );
+  fprintf( fp, "  %s_%s_DELAY();\n", PREFIX, BUS );
+  fprintf( fp, "  LPC_GPIO%d->FIOCLR = 0x%08lxu;\n", pc, scl );
+  fprintf( fp, "}\n");
+  fprintf( fp, "\n");
+  fprintf( fp, "// %s: 3 stores\n", sb->name );
+  print_softbus_generic( fp, 3, 0, 6 );
+  fprintf( fp, "void %s_gpio_%s_stop( void ) {\n", prefix, bus );
+  fprintf( fp, "  LPC_GPIO%d->FIOCLR = 0x%08lxu;\n", pd, sda );
+  fprintf( fp, "  %s_%s_DELAY();\n", PREFIX, BUS );
+  fprintf( fp, "  LPC_GPIO%d->FIOSET = 0x%08lxu;\n", pc, scl );
+  fprintf( fp, "  %s_%s_DELAY();\n", PREFIX, BUS );
+  fprintf( fp, "  LPC_GPIO%d->FIOSET = 0x%08lxu;\n", pd, sda );
+  fprintf( fp, "  %s_%s_DELAY();\n", PREFIX, BUS );
+  fprintf( fp, "}\n");
+
+  fprintf( fp, "\n");
+  fprintf( fp, "// %s: %d stores and 1 load per byte\n", sb->name, 8*4+3 );
+  print_softbus_generic( fp, 8*3+3, 1, 2*(8*3+3+1) );
+  fprintf( fp, "int %s_gpio_%s_write( uint8_t out ) {\n", prefix, bus );
+  fprintf( fp, "  uint32_t v;\n");
+  for(b=7;b>=0;b--) {
+    sb_shift( temp, "(uint32_t)out", b, pins[sb->pin[SB_SDA]].bit );
+    fprintf( fp, "  v = %s;\n", temp );
+    fprintf( fp, "  LPC_GPIO%d->FIOSET = v;\n", pd );
+    fprintf( fp, "  LPC_GPIO%d->FIOCLR = v ^ 0x%08lxu;\n", pd, sda );
+    fprintf( fp, "  %s_%s_DELAY();\n", PREFIX, BUS );
+    fprintf( fp, "  LPC_GPIO%d->FIOSET = 0x%08lxu;\n", pc, scl );
+    fprintf( fp, "  %s_%s_DELAY();\n", PREFIX, BUS );
+    fprintf( fp, "  LPC_GPIO%d->FIOCLR = 0x%08lxu;\n", pc, scl );
+  }
+  fprintf( fp, "  LPC_GPIO%d->FIOSET = 0x%08lxu;\n", pd, sda );
+  fprintf( fp, "  %s_%s_DELAY();\n", PREFIX, BUS );
+  fprintf( fp, "  LPC_GPIO%d->FIOSET = 0x%08lxu;\n", pc, scl );
+  fprintf( fp, "  %s_%s_DELAY();\n", PREFIX, BUS );
+  if(opt_bitband) fprintf( fp, "  v = %s_BB_PIN_%s;\n", PREFIX, pins[sb->pin[SB_SDA]].signame );
+  else            fprintf( fp, "  v = LPC_GPIO%d->FIOPIN & 0x%08lxu;\n", pd, sda );
+  fprintf( fp, "  LPC_GPIO%d->FIOCLR = 0x%08lxu;\n", pc, scl );
+  fprintf( fp, "  return v != 0;\n");
+  fprintf( fp, "}\n");
+
+  fprintf( fp, "\n");
+  fprintf( fp, "// %s: %d stores (%d with ack) and 8 loads per byte\n", sb->name, 1+8*2+3, 1+8*2+4 );
+  fprintf( fp, "// (generic pin-table driver: %d stores (%d with ack), 8 loads and %d (%d) table reads)\n",
+           1+8*2+3, 1+8*2+4, 2*(1+8*3+3), 2*(1+8*3+4) );
+  fprintf( fp, "uint8_t %s_gpio_%s_read( int ack ) {\n", prefix, bus );
+  fprintf( fp, "  uint32_t in = 0;\n");
+  fprintf( fp, "  LPC_GPIO%d->FIOSET = 0x%08lxu;\n", pd, sda );
+  for(b=7;b>=0;b--) {
+    fprintf( fp, "  %s_%s_DELAY();\n", PREFIX, BUS );
+    fprintf( fp, "  LPC_GPIO%d->FIOSET = 0x%08lxu;\n", pc, scl );
+    fprintf( fp, "  %s_%s_DELAY();\n", PREFIX, BUS );
+    print_softbus_read( fp, sb, SB_SDA, b );
+    fprintf( fp, "  LPC_GPIO%d->FIOCLR = 0x%08lxu;\n", pc, scl );
+  }
+  fprintf( fp, "  if(ack) LPC_GPIO%d->FIOCLR = 0x%08lxu;\n", pd, sda );
+  fprintf( fp, "  %s_%s_DELAY();\n", PREFIX, BUS );
+  fprintf( fp, "  LPC_GPIO%d->FIOSET = 0x%08lxu;\n", pc, scl );
+  fprintf( fp, "  %s_%s_DELAY();\n", PREFIX, BUS );
+  fprintf( fp, "  LPC_GPIO%d->FIOCLR = 0x%08lxu;\n", pc, scl );
+  fprintf( fp, "  LPC_GPIO%d->FIOSET = 0x%08lxu;\n", pd, sda );
+  fprintf( fp, "  return in;\n");
+  fprintf( fp, "}\n");
+}
+
+void print_softbus_c( FILE *fp ) {
+  int j;
+  char BUS[MAXCHARS], bus[MAXCHARS];
+  SOFTBUSDEF *sb;
+  for(j=0;j<nsoftbus;j++) {
+    sb=&softbus[j];
+    if(!sb->valid) continue;
+    softbus_ident( BUS, sb, true );
+    softbus_ident( bus, sb, false );
+    if(sb->type==SB_SPI) print_softbus_spi( fp, sb, BUS, bus );
+    else                 print_softbus_i2c( fp, sb, BUS, bus );
+  }
+}
+
+
+//************************************************************************
+// Host register simulator
+//************************************************************************
+// -sim writes prefix_sim.hpp and prefix_sim.cpp.  Compiled as C++ with
+// PREFIX_SIM defined, prefix_gpio.c takes its LPC_xxx definitions from
+// prefix_sim.hpp instead of LPC17xx.h, and each register becomes a proxy
+// object with GPIO set/clear/mask and open-drain behaviour that counts
+// every load and store.  prefix_sim.cpp holds the register file and a
+// self-test for this pinout whose output is the number of accesses each
+// macro and routine makes, so changes to the generator can be measured
+// on the build host.
+void print_sim_hpp( FILE *fp ) {
+  fprintf( fp, "#ifndef %s_SIM_HPP\n", PREFIX );
+  fprintf( fp, "#define %s_SIM_HPP\n", PREFIX );
+  fprintf( fp, "// Host model of the LPC17xx registers used by %s_gpio.c/h.  Build the\n", prefix );
+  fprintf( fp, "// generated C as C++ with %s_SIM defined, together with %s_sim.cpp:\n", PREFIX, prefix );
+  fprintf( fp, "//   g++ -D%s_SIM -x c++ %s_gpio.c %s_sim.cpp -o %s_sim\n", PREFIX, prefix, prefix, prefix );
+  fprintf( fp, "// Each LPC_xxx register is a proxy object, so every load and store the\n");
+  fprintf( fp, "// generated code makes is counted against the register it touches.\n");
+  fprintf( fp, "#include <stdint.h>\n");
+  fprintf( fp, "#include <stdio.h>\n");
+  fprintf( fp, "\n");
+  fprintf( fp, "#pragma GCC diagnostic ignored \"-Wwrite-strings\"\n");
+  fprintf( fp, "\n");
+  fprintf( fp, "namespace %s_sim {\n", prefix );
+  fprintf( fp, "\n");
+  fprintf( fp, "struct Count {\n");
+  fprintf( fp, "  unsigned long loads;\n");
+  fprintf( fp, "  unsigned long stores;\n");
+  fprintf( fp, "};\n");
+  fprintf( fp, "extern unsigned long loads;   // all registers\n");
+  fprintf( fp, "extern unsigned long stores;\n");
+  fprintf( fp, "\n");
+  fprintf( fp, "// Time advances by a fixed number of CPU cycles per access; pins are\n");
+  fprintf( fp, "// sampled after every access, and each change of a signal's level is\n");
+  fprintf( fp, "// counted and, with a VCD file open, written to it.\n");
+  fprintf( fp, "extern unsigned long cycles;\n");
+  fprintf( fp, "extern unsigned long cycles_per_load;\n");
+  fprintf( fp, "extern unsigned long cycles_per_store;\n");
+  fprintf( fp, "extern unsigned long clock_hz;\n");
+  fprintf( fp, "void sample( void );\n");
+  fprintf( fp, "\n");
+  fprintf( fp, "class Register {\n");
+  fprintf( fp, "public:\n");
+  fprintf( fp, "  Count *count;\n");
+  fprintf( fp, "  virtual uint32_t get( void ) const = 0;  // value without counting an access\n");
+  fprintf( fp, "  virtual void put( uint32_t v ) = 0;\n");
+  fprintf( fp, "  uint32_t load( void ) { count->loads++; loads++; cycles+=cycles_per_load; return get(); }\n");
+  fprintf( fp, "  void store( uint32_t v ) { count->stores++; stores++; cycles+=cycles_per_store; put( v ); sample(); }\n");
+  fprintf( fp, "};\n");
+  fprintf( fp, "\n");
+  fprintf( fp, "// Plain read/write register\n");
+  fprintf( fp, "class Reg : public Register {\n");
+  fprintf( fp, "public:\n");
+  fprintf( fp, "  uint32_t v;\n");
+  fprintf( fp, "  Count c;\n");
+  fprintf( fp, "  Reg() { v=0; c.loads=c.stores=0; count=&c; }\n");
+  fprintf( fp, "  uint32_t get( void ) const { return v; }\n");
+  fprintf( fp, "  void put( uint32_t x ) { v=x; }\n");
+  fprintf( fp, "  operator uint32_t() { return load(); }\n");
+  fprintf( fp, "  Reg &operator=( uint32_t x ) { store( x ); return *this; }\n");
+  fprintf( fp, "  Reg &operator=( Reg &r ) { store( r.load() ); return *this; }\n");
+  fprintf( fp, "  Reg &operator|=( uint32_t x ) { store( load() | x ); return *this; }\n");
+  fprintf( fp, "  Reg &operator&=( uint32_t x ) { store( load() & x ); return *this; }\n");
+  fprintf( fp, "  Reg &operator^=( uint32_t x ) { store( load() ^ x ); return *this; }\n");
+  fprintf( fp, "};\n");
+  fprintf( fp, "\n");
+  fprintf( fp, "enum { DIR, MASK, PIN, SET, CLR };\n");
+  fprintf( fp, "\n");
+  fprintf( fp, "class Port;\n");
+  fprintf( fp, "\n");
+  fprintf( fp, "// A GPIO register, or a byte or halfword lane of one\n");
+  fprintf( fp, "class GpioReg : public Register {\n");
+  fprintf( fp, "public:\n");
+  fprintf( fp, "  Port *port;\n");
+  fprintf( fp, "  int kind;\n");
+  fprintf( fp, "  int shift;\n");
+  fprintf( fp, "  uint32_t lane;\n");
+  fprintf( fp, "  void init( Port *p, int k, int sh, uint32_t ln );\n");
+  fprintf( fp, "  uint32_t get( void ) const;\n");
+  fprintf( fp, "  void put( uint32_t x );\n");
+  fprintf( fp, "  operator uint32_t() { return load(); }\n");
+  fprintf( fp, "  GpioReg &operator=( uint32_t x ) { store( x ); return *this; }\n");
+  fprintf( fp, "  GpioReg &operator=( GpioReg &r ) { store( r.load() ); return *this; }\n");
+  fprintf( fp, "  GpioReg &operator|=( uint32_t x ) { store( load() | x ); return *this; }\n");
+  fprintf( fp, "  GpioReg &operator&=( uint32_t x ) { store( load() & x ); return *this; }\n");
+  fprintf( fp, "  GpioReg &operator^=( uint32_t x ) { store( load() ^ x ); return *this; }\n");
+  fprintf( fp, "};\n");
+  fprintf( fp, "\n");
+  fprintf( fp, "// FIOSET/FIOCLR/FIOPIN writes only reach bits clear in FIOMASK, and\n");
+  fprintf( fp, "// FIOPIN/FIOSET reads return 0 for masked bits.  A pin reads its output\n");
+  fprintf( fp, "// latch when it is a push-pull output, ext when it is an input, and the\n");
+  fprintf( fp, "// AND of both when it is an open-drain output.\n");
+  fprintf( fp, "class Port {\n");
+  fprintf( fp, "public:\n");
+  fprintf( fp, "  uint32_t dir;\n");
+  fprintf( fp, "  uint32_t mask;\n");
+  fprintf( fp, "  uint32_t latch;\n");
+  fprintf( fp, "  uint32_t ext;         // level applied from outside, 1 = pulled up\n");
+  fprintf( fp, "  Count count[5];       // FIODIR, FIOMASK, FIOPIN, FIOSET, FIOCLR, all lanes\n");
+  fprintf( fp, "  GpioReg FIODIR, FIODIRL, FIODIRH, FIODIR0, FIODIR1, FIODIR2, FIODIR3;\n");
+  fprintf( fp, "  GpioReg FIOMASK, FIOMASKL, FIOMASKH, FIOMASK0, FIOMASK1, FIOMASK2, FIOMASK3;\n");
+  fprintf( fp, "  GpioReg FIOPIN, FIOPINL, FIOPINH, FIOPIN0, FIOPIN1, FIOPIN2, FIOPIN3;\n");
+  fprintf( fp, "  GpioReg FIOSET, FIOSETL, FIOSETH, FIOSET0, FIOSET1, FIOSET2, FIOSET3;\n");
+  fprintf( fp, "  GpioReg FIOCLR, FIOCLRL, FIOCLRH, FIOCLR0, FIOCLR1, FIOCLR2, FIOCLR3;\n");
+  fprintf( fp, "  Port();\n");
+  fprintf( fp, "  int num( void ) const;\n");
+  fprintf( fp, "  uint32_t pins( void ) const;\n");
+  fprintf( fp, "};\n");
+  fprintf( fp, "\n");
+  fprintf( fp, "struct Pincon {\n");
+  fprintf( fp, "  Reg PINSEL0, PINSEL1, PINSEL2, PINSEL3, PINSEL4, PINSEL5, PINSEL6, PINSEL7, PINSEL8, PINSEL9, PINSEL10;\n");
+  fprintf( fp, "  Reg RESERVED0[5];\n");
+  fprintf( fp, "  Reg PINMODE0, PINMODE1, PINMODE2, PINMODE3, PINMODE4, PINMODE5, PINMODE6, PINMODE7, PINMODE8, PINMODE9;\n");
+  fprintf( fp, "  Reg PINMODE_OD0, PINMODE_OD1, PINMODE_OD2, PINMODE_OD3, PINMODE_OD4;\n");
+  fprintf( fp, "  Reg I2CPADCFG;\n");
+  fprintf( fp, "};\n");
+  fprintf( fp, "\n");
+  fprintf( fp, "struct GpioInt {\n");
+  fprintf( fp, "  Reg IntStatus, IO0IntStatR, IO0IntStatF, IO0IntClr, IO0IntEnR, IO0IntEnF;\n");
+  fprintf( fp, "  Reg IO2IntStatR, IO2IntStatF, IO2IntClr, IO2IntEnR, IO2IntEnF;\n");
+  fprintf( fp, "};\n");
+  fprintf( fp, "\n");
+  fprintf( fp, "struct Sc {\n");
+  fprintf( fp, "  Reg PCONP;\n");
+  fprintf( fp, "};\n");
+  fprintf( fp, "\n");
+  fprintf( fp, "struct Adc {\n");
+  fprintf( fp, "  Reg ADCR, ADGDR, ADINTEN, ADDR0, ADDR1, ADDR2, ADDR3, ADDR4, ADDR5, ADDR6, ADDR7, ADSTAT, ADTRM;\n");
+  fprintf( fp, "};\n");
+  fprintf( fp, "\n");
+  fprintf( fp, "struct Pwm {\n");
+  fprintf( fp, "  Reg IR, TCR, TC, PR, PC, MCR, MR0, MR1, MR2, MR3, CCR, CR0, CR1, CR2, CR3;\n");
+  fprintf( fp, "  Reg MR4, MR5, MR6, PCR, LER, CTCR;\n");
+  fprintf( fp, "};\n");
+  fprintf( fp, "\n");
+  fprintf( fp, "struct Tim {\n");
+  fprintf( fp, "  Reg IR, TCR, TC, PR, PC, MCR, MR0, MR1, MR2, MR3, CCR, CR0, CR1, EMR, CTCR;\n");
+  fprintf( fp, "};\n");
+  fprintf( fp, "\n");
+  fprintf( fp, "extern Port gpio[5];\n");
+  fprintf( fp, "extern Pincon pincon;\n");
+  fprintf( fp, "extern GpioInt gpioint;\n");
+  fprintf( fp, "extern Sc sc;\n");
+  fprintf( fp, "extern Adc adc;\n");
+  fprintf( fp, "extern Pwm pwm1;\n");
+  fprintf( fp, "extern Tim tim[4];\n");
+  fprintf( fp, "\n");
+  fprintf( fp, "// A bit-band alias word, mapped back onto the register it aliases.  A\n");
+  fprintf( fp, "// write is one store that changes one bit of the register, as the bus\n");
+  fprintf( fp, "// does it: a read-modify-write of the whole word.\n");
+  fprintf( fp, "class BitBand {\n");
+  fprintf( fp, "public:\n");
+  fprintf( fp, "  Register *reg;\n");
+  fprintf( fp, "  int bit;\n");
+  fprintf( fp, "  BitBand( uint32_t alias );\n");
+  fprintf( fp, "  operator uint32_t() { return (reg->load() >> bit) & 1; }\n");
+  fprintf( fp, "  BitBand &operator=( uint32_t x ) {\n");
+  fprintf( fp, "    reg->count->stores++;\n");
+  fprintf( fp, "    stores++;\n");
+  fprintf( fp, "    cycles+=cycles_per_store;\n");
+  fprintf( fp, "    reg->put( (reg->get() & ~(1UL<<bit)) | ((x & 1UL)<<bit) );\n");
+  fprintf( fp, "    sample();\n");
+  fprintf( fp, "    return *this;\n");
+  fprintf( fp, "  }\n");
+  fprintf( fp, "};\n");
+  fprintf( fp, "\n");
+  fprintf( fp, "struct Signal {             // a pin from the CSV, for labels\n");
+  fprintf( fp, "  int port;\n");
+  fprintf( fp, "  int bit;\n");
+  fprintf( fp, "  const char *name;\n");
+  fprintf( fp, "  unsigned long transitions;\n");
+  fprintf( fp, "  char level;               // '0', '1', or 'z' when PINSEL picks a peripheral\n");
+  fprintf( fp, "};\n");
+  fprintf( fp, "extern Signal signals[];\n");
+  fprintf( fp, "extern const int nsignals;\n");
+  fprintf( fp, "\n");
+  fprintf( fp, "void reset( void );         // registers to zero, inputs pulled high\n");
+  fprintf( fp, "void clear_counts( void );\n");
+  fprintf( fp, "void report( FILE *fp );    // accesses per register since clear_counts()\n");
+  fprintf( fp, "void report_transitions( FILE *fp );\n");
+  fprintf( fp, "int vcd_open( const char *fname );  // 0 if the file can't be written\n");
+  fprintf( fp, "void vcd_close( void );\n");
+  fprintf( fp, "\n");
+  fprintf( fp, "} // namespace %s_sim\n", prefix );
+  fprintf( fp, "\n");
+  fprintf( fp, "#define %s_BB_WORD(a) (%s_sim::BitBand(a))\n", PREFIX, prefix );
+  fprintf( fp, "\n");
+  fprintf( fp, "typedef %s_sim::Port LPC_GPIO_TypeDef;\n", prefix );
+  fprintf( fp, "#define LPC_GPIO0   (&%s_sim::gpio[0])\n", prefix );
+  fprintf( fp, "#define LPC_GPIO1   (&%s_sim::gpio[1])\n", prefix );
+  fprintf( fp, "#define LPC_GPIO2   (&%s_sim::gpio[2])\n", prefix );
+  fprintf( fp, "#define LPC_GPIO3   (&%s_sim::gpio[3])\n", prefix );
+  fprintf( fp, "#define LPC_GPIO4   (&%s_sim::gpio[4])\n", prefix );
+  fprintf( fp, "#define LPC_PINCON  (&%s_sim::pincon)\n", prefix );
+  fprintf( fp, "#define LPC_GPIOINT (&%s_sim::gpioint)\n", prefix );
+  fprintf( fp, "#define LPC_SC      (&%s_sim::sc)\n", prefix );
+  fprintf( fp, "#define LPC_ADC     (&%s_sim::adc)\n", prefix );
+  fprintf( fp, "#define LPC_PWM1    (&%s_sim::pwm1)\n", prefix );
+  fprintf( fp, "#define LPC_TIM0    (&%s_sim::tim[0])\n", prefix );
+  fprintf( fp, "#define LPC_TIM1    (&%s_sim::tim[1])\n", prefix );
+  fprintf( fp, "#define LPC_TIM2    (&%s_sim::tim[2])\n", prefix );
+  fprintf( fp, "#define LPC_TIM3    (&%s_sim::tim[3])\n", prefix );
+  fprintf( fp, "\n");
+  fprintf( fp, "typedef enum { EINT3_IRQn = 21 } IRQn_Type;\n");
+  fprintf( fp, "static inline void NVIC_EnableIRQ( IRQn_Type irq ) { (void)irq; }\n");
+  fprintf( fp, "static inline uint32_t __CLZ( uint32_t x ) { return x ? __builtin_clz(x) : 32; }\n");
+  if(opt_trace) {
+    fprintf( fp, "#define %s_TRACE_TIME() ((uint32_t)%s_sim::cycles)\n", PREFIX, prefix );
+  }
+  fprintf( fp, "\n");
+  fprintf( fp, "#endif\n");
+
+}
+
+void print_sim_model_cpp( FILE *fp ) {
+  fprintf( fp, "#include <stdlib.h>\n");
+  fprintf( fp, "#include <string.h>\n");
+  fprintf( fp, "#include \"%s_sim.hpp\"\n", prefix );
+  fprintf( fp, "#include \"%s_gpio.h\"\n", prefix );
+  fprintf( fp, "\n");
+  fprintf( fp, "namespace %s_sim {\n", prefix );
+  fprintf( fp, "\n");
+  fprintf( fp, "unsigned long loads;\n");
+  fprintf( fp, "unsigned long stores;\n");
+  fprintf( fp, "unsigned long cycles;\n");
+  fprintf( fp, "unsigned long cycles_per_load=2;   // AHB GPIO: load has one wait for the data phase\n");
+  fprintf( fp, "unsigned long cycles_per_store=1;\n");
+  fprintf( fp, "unsigned long clock_hz=100000000UL;\n");
+  fprintf( fp, "Port gpio[5];\n");
+  fprintf( fp, "Pincon pincon;\n");
+  fprintf( fp, "GpioInt gpioint;\n");
+  fprintf( fp, "Sc sc;\n");
+  fprintf( fp, "Adc adc;\n");
+  fprintf( fp, "Pwm pwm1;\n");
+  fprintf( fp, "Tim tim[4];\n");
+  fprintf( fp, "\n");
+  fprintf( fp, "static const char *kind_name[5] = { \"FIODIR\", \"FIOMASK\", \"FIOPIN\", \"FIOSET\", \"FIOCLR\" };\n");
+  fprintf( fp, "\n");
+  fprintf( fp, "void GpioReg::init( Port *p, int k, int sh, uint32_t ln ) {\n");
+  fprintf( fp, "  port=p;\n");
+  fprintf( fp, "  kind=k;\n");
+  fprintf( fp, "  shift=sh;\n");
+  fprintf( fp, "  lane=ln;\n");
+  fprintf( fp, "  count=&p->count[k];\n");
+  fprintf( fp, "}\n");
+  fprintf( fp, "\n");
+  fprintf( fp, "uint32_t GpioReg::get( void ) const {\n");
+  fprintf( fp, "  uint32_t v;\n");
+  fprintf( fp, "  switch(kind) {\n");
+  fprintf( fp, "    case DIR:  v=port->dir; break;\n");
+  fprintf( fp, "    case MASK: v=port->mask; break;\n");
+  fprintf( fp, "    case PIN:  v=port->pins() & ~port->mask; break;\n");
+  fprintf( fp, "    case SET:  v=port->latch & ~port->mask; break;\n");
+  fprintf( fp, "    default:   v=0; break;  // FIOCLR is write-only\n");
+  fprintf( fp, "  }\n");
+  fprintf( fp, "  return (v >> shift) & lane;\n");
+  fprintf( fp, "}\n");
+  fprintf( fp, "\n");
+  fprintf( fp, "void GpioReg::put( uint32_t x ) {\n");
+  fprintf( fp, "  uint32_t w, m;\n");
+  fprintf( fp, "  w=(x & lane) << shift;\n");
+  fprintf( fp, "  m=lane << shift;\n");
+  fprintf( fp, "  switch(kind) {\n");
+  fprintf( fp, "    case DIR:  port->dir = (port->dir & ~m) | w; break;\n");
+  fprintf( fp, "    case MASK: port->mask = (port->mask & ~m) | w; break;\n");
+  fprintf( fp, "    case PIN:  m &= ~port->mask; port->latch = (port->latch & ~m) | (w & m); break;\n");
+  fprintf( fp, "    case SET:  port->latch |= w & ~port->mask; break;\n");
+  fprintf( fp, "    case CLR:  port->latch &= ~(w & ~port->mask); break;\n");
+  fprintf( fp, "  }\n");
+  fprintf( fp, "}\n");
+  fprintf( fp, "\n");
+  fprintf( fp, "static void lanes( Port *p, int k, GpioReg *w, GpioReg *l, GpioReg *h, GpioReg *b ) {\n");
+  fprintf( fp, "  int i;\n");
+  fprintf( fp, "  w->init( p, k, 0, 0xffffffffUL );\n");
+  fprintf( fp, "  l->init( p, k, 0, 0xffff );\n");
+  fprintf( fp, "  h->init( p, k, 16, 0xffff );\n");
+  fprintf( fp, "  for(i=0;i<4;i++) b[i].init( p, k, 8*i, 0xff );\n");
+  fprintf( fp, "}\n");
+  fprintf( fp, "\n");
+  fprintf( fp, "Port::Port() {\n");
+  fprintf( fp, "  int k;\n");
+  fprintf( fp, "  dir=mask=latch=0;\n");
+  fprintf( fp, "  ext=0xffffffffUL;\n");
+  fprintf( fp, "  for(k=0;k<5;k++) count[k].loads=count[k].stores=0;\n");
+  fprintf( fp, "  lanes( this, DIR,  &FIODIR,  &FIODIRL,  &FIODIRH,  &FIODIR0 );\n");
+  fprintf( fp, "  lanes( this, MASK, &FIOMASK, &FIOMASKL, &FIOMASKH, &FIOMASK0 );\n");
+  fprintf( fp, "  lanes( this, PIN,  &FIOPIN,  &FIOPINL,  &FIOPINH,  &FIOPIN0 );\n");
+  fprintf( fp, "  lanes( this, SET,  &FIOSET,  &FIOSETL,  &FIOSETH,  &FIOSET0 );\n");
+  fprintf( fp, "  lanes( this, CLR,  &FIOCLR,  &FIOCLRL,  &FIOCLRH,  &FIOCLR0 );\n");
+  fprintf( fp, "}\n");
+  fprintf( fp, "\n");
+  fprintf( fp, "int Port::num( void ) const {\n");
+  fprintf( fp, "  return (int)(this - gpio);\n");
+  fprintf( fp, "}\n");
+  fprintf( fp, "\n");
+  fprintf( fp, "uint32_t Port::pins( void ) const {\n");
+  fprintf( fp, "  uint32_t od;\n");
+  fprintf( fp, "  od=(&pincon.PINMODE_OD0)[num()].v;\n");
+  fprintf( fp, "  return (latch & dir & ~od) | (latch & ext & dir & od) | (ext & ~dir);\n");
+  fprintf( fp, "}\n");
+  fprintf( fp, "\n");
+  fprintf( fp, "BitBand::BitBand( uint32_t alias ) {\n");
+  fprintf( fp, "  uint32_t region, word;\n");
+  fprintf( fp, "  int n;\n");
+  fprintf( fp, "  region = alias & 0xF0000000UL;\n");
+  fprintf( fp, "  word = region + (((alias - region - 0x02000000UL) >> 5) & ~3UL);\n");
+  fprintf( fp, "  bit = (alias >> 2) & 31;\n");
+  fprintf( fp, "  reg = NULL;\n");
+  fprintf( fp, "  if((word>=0x2009C000UL) && (word<0x2009C0A0UL)) {\n");
+  fprintf( fp, "    n = (word-0x2009C000UL)/0x20;\n");
+  fprintf( fp, "    switch(word & 0x1f) {\n");
+  fprintf( fp, "      case 0x00: reg=&gpio[n].FIODIR; break;\n");
+  fprintf( fp, "      case 0x10: reg=&gpio[n].FIOMASK; break;\n");
+  fprintf( fp, "      case 0x14: reg=&gpio[n].FIOPIN; break;\n");
+  fprintf( fp, "      case 0x18: reg=&gpio[n].FIOSET; break;\n");
+  fprintf( fp, "      case 0x1c: reg=&gpio[n].FIOCLR; break;\n");
+  fprintf( fp, "    }\n");
+  fprintf( fp, "  }\n");
+  fprintf( fp, "  if((word>=0x4002C000UL) && (word<0x4002C080UL)) {\n");
+  fprintf( fp, "    reg=&(&pincon.PINSEL0)[(word-0x4002C000UL)/4];\n");
+  fprintf( fp, "  }\n");
+  fprintf( fp, "  if(!reg) {\n");
+  fprintf( fp, "    fprintf(stderr,\"%s_sim: no register behind bit-band alias 0x%%08lx\\n\", (unsigned long)alias );\n", prefix );
+  fprintf( fp, "    exit(99);\n");
+  fprintf( fp, "  }\n");
+  fprintf( fp, "}\n");
+  fprintf( fp, "\n");
+  fprintf( fp, "static FILE *vcd;\n");
+  fprintf( fp, "static unsigned long vcd_time;   // last timestamp written\n");
+  fprintf( fp, "\n");
+  fprintf( fp, "static char signal_level( Signal *s ) {\n");
+  fprintf( fp, "  uint32_t sel;\n");
+  fprintf( fp, "  sel=(&pincon.PINSEL0)[s->port*2 + s->bit/16].v >> (2*(s->bit%%16));\n");
+  fprintf( fp, "  if(sel & 3) return 'z';\n");
+  fprintf( fp, "  return ((gpio[s->port].pins() >> s->bit) & 1) ? '1' : '0';\n");
+  fprintf( fp, "}\n");
+  fprintf( fp, "\n");
+  fprintf( fp, "// VCD identifiers are printable characters from '!' on, base 94\n");
+  fprintf( fp, "static void vcd_id( char *id, int n ) {\n");
+  fprintf( fp, "  do {\n");
+  fprintf( fp, "    *id++ = '!' + n%%94;\n");
+  fprintf( fp, "    n /= 94;\n");
+  fprintf( fp, "  } while(n);\n");
+  fprintf( fp, "  *id=0;\n");
+  fprintf( fp, "}\n");
+  fprintf( fp, "\n");
+  fprintf( fp, "static unsigned long ns( unsigned long cyc ) {\n");
+  fprintf( fp, "  return (unsigned long)((double)cyc * 1e9 / clock_hz);\n");
+  fprintf( fp, "}\n");
+  fprintf( fp, "\n");
+  fprintf( fp, "void sample( void ) {\n");
+  fprintf( fp, "  int i;\n");
+  fprintf( fp, "  char c;\n");
+  fprintf( fp, "  char id[8];\n");
+  fprintf( fp, "  for(i=0;i<nsignals;i++) {\n");
+  fprintf( fp, "    c=signal_level( &signals[i] );\n");
+  fprintf( fp, "    if(c==signals[i].level) continue;\n");
+  fprintf( fp, "    signals[i].level=c;\n");
+  fprintf( fp, "    signals[i].transitions++;\n");
+  fprintf( fp, "    if(!vcd) continue;\n");
+  fprintf( fp, "    if(ns(cycles)!=vcd_time) {\n");
+  fprintf( fp, "      vcd_time=ns(cycles);\n");
+  fprintf( fp, "      fprintf( vcd, \"#%%lu\\n\", vcd_time );\n");
+  fprintf( fp, "    }\n");
+  fprintf( fp, "    vcd_id( id, i );\n");
+  fprintf( fp, "    fprintf( vcd, \"%%c%%s\\n\", c, id );\n");
+  fprintf( fp, "  }\n");
+  fprintf( fp, "}\n");
+  fprintf( fp, "\n");
+  fprintf( fp, "int vcd_open( const char *fname ) {\n");
+  fprintf( fp, "  int i;\n");
+  fprintf( fp, "  char id[8];\n");
+  fprintf( fp, "  vcd=fopen( fname, \"w\" );\n");
+  fprintf( fp, "  if(!vcd) return 0;\n");
+  fprintf( fp, "  fprintf( vcd, \"$version %s_sim, %%lu Hz, %%lu/%%lu cycles per load/store $end\\n\",\n", prefix );
+  fprintf( fp, "           clock_hz, cycles_per_load, cycles_per_store );\n");
+  fprintf( fp, "  fprintf( vcd, \"$timescale 1 ns $end\\n\");\n");
+  fprintf( fp, "  fprintf( vcd, \"$scope module %s $end\\n\");\n", prefix );
+  fprintf( fp, "  for(i=0;i<nsignals;i++) {\n");
+  fprintf( fp, "    vcd_id( id, i );\n");
+  fprintf( fp, "    fprintf( vcd, \"$var wire 1 %%s %%s $end\\n\", id, signals[i].name );\n");
+  fprintf( fp, "  }\n");
+  fprintf( fp, "  fprintf( vcd, \"$upscope $end\\n\");\n");
+  fprintf( fp, "  fprintf( vcd, \"$enddefinitions $end\\n\");\n");
+  fprintf( fp, "  vcd_time=ns(cycles);\n");
+  fprintf( fp, "  fprintf( vcd, \"#%%lu\\n\", vcd_time );\n");
+  fprintf( fp, "  fprintf( vcd, \"$dumpvars\\n\");\n");
+  fprintf( fp, "  for(i=0;i<nsignals;i++) {\n");
+  fprintf( fp, "    vcd_id( id, i );\n");
+  fprintf( fp, "    signals[i].level=signal_level( &signals[i] );\n");
+  fprintf( fp, "    fprintf( vcd, \"%%c%%s\\n\", signals[i].level, id );\n");
+  fprintf( fp, "  }\n");
+  fprintf( fp, "  fprintf( vcd, \"$end\\n\");\n");
+  fprintf( fp, "  return 1;\n");
+  fprintf( fp, "}\n");
+  fprintf( fp, "\n");
+  fprintf( fp, "void vcd_close( void ) {\n");
+  fprintf( fp, "  if(!vcd) return;\n");
+  fprintf( fp, "  fprintf( vcd, \"#%%lu\\n\", ns(cycles) );\n");
+  fprintf( fp, "  fclose( vcd );\n");
+  fprintf( fp, "  vcd=NULL;\n");
+  fprintf( fp, "}\n");
+  fprintf( fp, "\n");
+  fprintf( fp, "void report_transitions( FILE *fp ) {\n");
+  fprintf( fp, "  int i;\n");
+  fprintf( fp, "  for(i=0;i<nsignals;i++) {\n");
+  fprintf( fp, "    if(signals[i].transitions) fprintf( fp, \"  %%-28s %%8lu\\n\", signals[i].name, signals[i].transitions );\n");
+  fprintf( fp, "  }\n");
+  fprintf( fp, "}\n");
+  fprintf( fp, "\n");
+  fprintf( fp, "// every peripheral block is an array of Reg in register order\n");
+  fprintf( fp, "struct Block {\n");
+  fprintf( fp, "  const char *name;\n");
+  fprintf( fp, "  Reg *regs;\n");
+  fprintf( fp, "  int n;\n");
+  fprintf( fp, "  const char *names;  // blank-separated, \"-\" for reserved words\n");
+  fprintf( fp, "};\n");
+  fprintf( fp, "\n");
+  fprintf( fp, "static Block blocks[] = {\n");
+  fprintf( fp, "  { \"LPC_PINCON\", &pincon.PINSEL0, sizeof(Pincon)/sizeof(Reg),\n");
+  fprintf( fp, "    \"PINSEL0 PINSEL1 PINSEL2 PINSEL3 PINSEL4 PINSEL5 PINSEL6 PINSEL7 PINSEL8 PINSEL9 PINSEL10 - - - - - \"\n");
+  fprintf( fp, "    \"PINMODE0 PINMODE1 PINMODE2 PINMODE3 PINMODE4 PINMODE5 PINMODE6 PINMODE7 PINMODE8 PINMODE9 \"\n");
+  fprintf( fp, "    \"PINMODE_OD0 PINMODE_OD1 PINMODE_OD2 PINMODE_OD3 PINMODE_OD4 I2CPADCFG\" },\n");
+  fprintf( fp, "  { \"LPC_GPIOINT\", &gpioint.IntStatus, sizeof(GpioInt)/sizeof(Reg),\n");
+  fprintf( fp, "    \"IntStatus IO0IntStatR IO0IntStatF IO0IntClr IO0IntEnR IO0IntEnF \"\n");
+  fprintf( fp, "    \"IO2IntStatR IO2IntStatF IO2IntClr IO2IntEnR IO2IntEnF\" },\n");
+  fprintf( fp, "  { \"LPC_SC\", &sc.PCONP, sizeof(Sc)/sizeof(Reg), \"PCONP\" },\n");
+  fprintf( fp, "  { \"LPC_ADC\", &adc.ADCR, sizeof(Adc)/sizeof(Reg),\n");
+  fprintf( fp, "    \"ADCR ADGDR ADINTEN ADDR0 ADDR1 ADDR2 ADDR3 ADDR4 ADDR5 ADDR6 ADDR7 ADSTAT ADTRM\" },\n");
+  fprintf( fp, "  { \"LPC_PWM1\", &pwm1.IR, sizeof(Pwm)/sizeof(Reg),\n");
+  fprintf( fp, "    \"IR TCR TC PR PC MCR MR0 MR1 MR2 MR3 CCR CR0 CR1 CR2 CR3 MR4 MR5 MR6 PCR LER CTCR\" },\n");
+  fprintf( fp, "  { \"LPC_TIM0\", &tim[0].IR, sizeof(Tim)/sizeof(Reg), \"IR TCR TC PR PC MCR MR0 MR1 MR2 MR3 CCR CR0 CR1 EMR CTCR\" },\n");
+  fprintf( fp, "  { \"LPC_TIM1\", &tim[1].IR, sizeof(Tim)/sizeof(Reg), \"IR TCR TC PR PC MCR MR0 MR1 MR2 MR3 CCR CR0 CR1 EMR CTCR\" },\n");
+  fprintf( fp, "  { \"LPC_TIM2\", &tim[2].IR, sizeof(Tim)/sizeof(Reg), \"IR TCR TC PR PC MCR MR0 MR1 MR2 MR3 CCR CR0 CR1 EMR CTCR\" },\n");
+  fprintf( fp, "  { \"LPC_TIM3\", &tim[3].IR, sizeof(Tim)/sizeof(Reg), \"IR TCR TC PR PC MCR MR0 MR1 MR2 MR3 CCR CR0 CR1 EMR CTCR\" },\n");
+  fprintf( fp, "  { NULL, NULL, 0, NULL }\n");
+  fprintf( fp, "};\n");
+  fprintf( fp, "\n");
+  fprintf( fp, "void reset( void ) {\n");
+  fprintf( fp, "  int n, i;\n");
+  fprintf( fp, "  Block *b;\n");
+  fprintf( fp, "  for(n=0;n<5;n++) {\n");
+  fprintf( fp, "    gpio[n].dir=gpio[n].mask=gpio[n].latch=0;\n");
+  fprintf( fp, "    gpio[n].ext=0xffffffffUL;\n");
+  fprintf( fp, "  }\n");
+  fprintf( fp, "  for(b=blocks;b->name;b++) {\n");
+  fprintf( fp, "    for(i=0;i<b->n;i++) b->regs[i].v=0;\n");
+  fprintf( fp, "  }\n");
+  fprintf( fp, "  sample();\n");
+  fprintf( fp, "  clear_counts();\n");
+  fprintf( fp, "}\n");
+  fprintf( fp, "\n");
+  fprintf( fp, "void clear_counts( void ) {\n");
+  fprintf( fp, "  int n, i;\n");
+  fprintf( fp, "  Block *b;\n");
+  fprintf( fp, "  loads=stores=0;\n");
+  fprintf( fp, "  for(i=0;i<nsignals;i++) signals[i].transitions=0;\n");
+  fprintf( fp, "  for(n=0;n<5;n++) {\n");
+  fprintf( fp, "    for(i=0;i<5;i++) gpio[n].count[i].loads=gpio[n].count[i].stores=0;\n");
+  fprintf( fp, "  }\n");
+  fprintf( fp, "  for(b=blocks;b->name;b++) {\n");
+  fprintf( fp, "    for(i=0;i<b->n;i++) b->regs[i].c.loads=b->regs[i].c.stores=0;\n");
+  fprintf( fp, "  }\n");
+  fprintf( fp, "}\n");
+  fprintf( fp, "\n");
+  fprintf( fp, "void report( FILE *fp ) {\n");
+  fprintf( fp, "  int n, i, len;\n");
+  fprintf( fp, "  const char *np;\n");
+  fprintf( fp, "  Count *c;\n");
+  fprintf( fp, "  Block *b;\n");
+  fprintf( fp, "  char name[64];\n");
+  fprintf( fp, "  for(n=0;n<5;n++) {\n");
+  fprintf( fp, "    for(i=0;i<5;i++) {\n");
+  fprintf( fp, "      c=&gpio[n].count[i];\n");
+  fprintf( fp, "      if(!c->loads && !c->stores) continue;\n");
+  fprintf( fp, "      sprintf( name, \"LPC_GPIO%%d->%%s\", n, kind_name[i] );\n");
+  fprintf( fp, "      fprintf( fp, \"  %%-28s %%8lu loads %%8lu stores\\n\", name, c->loads, c->stores );\n");
+  fprintf( fp, "    }\n");
+  fprintf( fp, "  }\n");
+  fprintf( fp, "  for(b=blocks;b->name;b++) {\n");
+  fprintf( fp, "    np=b->names;\n");
+  fprintf( fp, "    for(i=0;i<b->n;i++) {\n");
+  fprintf( fp, "      len=strcspn(np,\" \");\n");
+  fprintf( fp, "      c=&b->regs[i].c;\n");
+  fprintf( fp, "      if(c->loads || c->stores) {\n");
+  fprintf( fp, "        sprintf( name, \"%%s->%%.*s\", b->name, len, np );\n");
+  fprintf( fp, "        fprintf( fp, \"  %%-28s %%8lu loads %%8lu stores\\n\", name, c->loads, c->stores );\n");
+  fprintf( fp, "      }\n");
+  fprintf( fp, "      np += len;\n");
+  fprintf( fp, "      if(*np) np++;\n");
+  fprintf( fp, "    }\n");
+  fprintf( fp, "  }\n");
+  fprintf( fp, "  fprintf( fp, \"  %%-28s %%8lu loads %%8lu stores\\n\", \"total\", loads, stores );\n");
+  fprintf( fp, "}\n");
+  fprintf( fp, "\n");
+  fprintf( fp, "} // namespace %s_sim\n", prefix );
+}
+
+// Per-pinout part of prefix_sim.cpp: the pins are checked against the
+// CSV after init, every SET/CLR/ON/OFF/GET macro is exercised, and each
+// generated routine is run once with its register accesses printed.
+bool sim_gpio_out( PINDEF *pd ) {
+  return (pd->func==0) && (pd->inout==OUT) && (pd->odrain!=1) && ((pd->active==0) || (pd->active==1));
+}
+
+bool sim_gpio_od( PINDEF *pd ) {
+  return (pd->func==0) && (pd->inout==OUT) && (pd->odrain==1);
+}
+
+bool sim_gpio_in( PINDEF *pd ) {
+  return (pd->func==0) && (pd->inout==IN);
+}
+
+void print_sim_check_pins( FILE *fp ) {
+  int i, reg, bit2;
+  PINDEF *pd;
+  fprintf( fp, "// registers against the per-pin settings in the CSV\n");
+  fprintf( fp, "static void check_pins( void ) {\n");
+  for(i=0;i<nseqs;i++) {
+    pd=&pins[i];
+    if((pd->port>4) || (pd->bit>31)) continue;
+    reg = pd->port*2 + pd->bit/16;
+    bit2 = 2*(pd->bit%16);
+    if((pd->func>=0) && (pd->func<=3)) {
+      fprintf( fp, "  check( (((&sim::pincon.PINSEL0)[%d].v >> %d) & 3) == %d, \"%s: FUNC\" );\n",
+                         reg, bit2, pd->func, pd->signame );
+    }
+    if((pd->mode>=0) && (pd->mode<=3)) {
+      fprintf( fp, "  check( (((&sim::pincon.PINMODE0)[%d].v >> %d) & 3) == %d, \"%s: MODE\" );\n",
+                         reg, bit2, pd->mode, pd->signame );
+    }
+    if((pd->odrain==0) || (pd->odrain==1)) {
+      fprintf( fp, "  check( (((&sim::pincon.PINMODE_OD0)[%d].v >> %d) & 1) == %d, \"%s: OD\" );\n",
+                         pd->port, pd->bit, pd->odrain, pd->signame );
+    }
+    if((pd->inout==IN) || (pd->inout==OUT)) {
+      fprintf( fp, "  check( ((sim::gpio[%d].dir >> %d) & 1) == %d, \"%s: IN/OUT\" );\n",
+                         pd->port, pd->bit, (pd->inout==OUT) ? 1 : 0, pd->signame );
+    }
+    if((pd->def==0) || (pd->def==1)) {
+      fprintf( fp, "  check( ((sim::gpio[%d].latch >> %d) & 1) == %d, \"%s: DEF\" );\n",
+                         pd->port, pd->bit, pd->def, pd->signame );
+    }
+  }
+  fprintf( fp, "}\n");
+}
+
+void print_sim_macros( FILE *fp ) {
+  int i, n;
+  PINDEF *pd;
+
+  for(n=0,i=0;i<nseqs;i++) if(sim_gpio_out(&pins[i])) n++;
+  if(n) {
+    fprintf( fp, "  mark();\n");
+    for(i=0;i<nseqs;i++) if(sim_gpio_out(&pins[i])) fprintf( fp, "  %s_ON_%s;\n", PREFIX, pins[i].signame );
+    fprintf( fp, "  bench( \"%s_ON_x\", %d );\n", PREFIX, n );
+    for(i=0;i<nseqs;i++) {
+      pd=&pins[i];
+      if(!sim_gpio_out(pd)) continue;
+      fprintf( fp, "  check( %s_QON_%s == 1, \"%s: ON\" );\n", PREFIX, pd->signame, pd->signame );
+    }
+    fprintf( fp, "  mark();\n");
+    for(i=0;i<nseqs;i++) if(sim_gpio_out(&pins[i])) fprintf( fp, "  %s_OFF_%s;\n", PREFIX, pins[i].signame );
+    fprintf( fp, "  bench( \"%s_OFF_x\", %d );\n", PREFIX, n );
+    fprintf( fp, "  mark();\n");
+    for(i=0;i<nseqs;i++) {
+      pd=&pins[i];
+      if(!sim_gpio_out(pd)) continue;
+      fprintf( fp, "  check( %s_QON_%s == 0, \"%s: OFF\" );\n", PREFIX, pd->signame, pd->signame );
+    }
+    fprintf( fp, "  bench( \"%s_QON_x\", %d );\n", PREFIX, n );
+    fprintf( fp, "  mark();\n");
+    for(i=0;i<nseqs;i++) if(sim_gpio_out(&pins[i])) fprintf( fp, "  %s_SET_%s;\n", PREFIX, pins[i].signame );
+    fprintf( fp, "  bench( \"%s_SET_x\", %d );\n", PREFIX, n );
+    for(i=0;i<nseqs;i++) {
+      pd=&pins[i];
+      if(!sim_gpio_out(pd)) continue;
+      fprintf( fp, "  check( %s_GET_%s == 1, \"%s: SET\" );\n", PREFIX, pd->signame, pd->signame );
+      fprintf( fp, "  %s_CLR_%s;\n", PREFIX, pd->signame );
+      fprintf( fp, "  check( %s_GET_%s == 0, \"%s: CLR\" );\n", PREFIX, pd->signame, pd->signame );
+    }
+  }
+
+  // open drain: released lines read the external pull-up, sunk ones 0
+  for(i=0;i<nseqs;i++) {
+    pd=&pins[i];
+    if(!sim_gpio_od(pd)) continue;
+    fprintf( fp, "  %s_OPEN_%s;\n", PREFIX, pd->signame );
+    fprintf( fp, "  check( %s_GET_%s == 1, \"%s: OPEN\" );\n", PREFIX, pd->signame, pd->signame );
+    fprintf( fp, "  %s_SINK_%s;\n", PREFIX, pd->signame );
+    fprintf( fp, "  check( %s_GET_%s == 0, \"%s: SINK\" );\n", PREFIX, pd->signame, pd->signame );
+  }
+
+  for(n=0,i=0;i<nseqs;i++) if(sim_gpio_in(&pins[i])) n++;
+  if(n) {
+    for(i=0;i<nseqs;i++) {
+      pd=&pins[i];
+      if(!sim_gpio_in(pd)) continue;
+      fprintf( fp, "  sim::gpio[%d].ext &= ~(1UL<<%d);\n", pd->port, pd->bit );
+    }
+    fprintf( fp, "  mark();\n");
+    for(i=0;i<nseqs;i++) {
+      pd=&pins[i];
+      if(!sim_gpio_in(pd)) continue;
+      fprintf( fp, "  check( %s_GET_%s == 0, \"%s: GET low\" );\n", PREFIX, pd->signame, pd->signame );
+    }
+    fprintf( fp, "  bench( \"%s_GET_x\", %d );\n", PREFIX, n );
+    for(i=0;i<nseqs;i++) {
+      pd=&pins[i];
+      if(!sim_gpio_in(pd)) continue;
+      fprintf( fp, "  sim::gpio[%d].ext |= 1UL<<%d;\n", pd->port, pd->bit );
+      fprintf( fp, "  check( %s_GET_%s == 1, \"%s: GET high\" );\n", PREFIX, pd->signame, pd->signame );
+    }
+  }
+}
+
+// run a generated routine once between mark() and bench()
+void print_sim_bench( FILE *fp, const char *call, const char *name ) {
+  fprintf( fp, "  mark();\n");
+  fprintf( fp, "  %s;\n", call );
+  fprintf( fp, "  bench( \"%s\", 1 );\n", name );
+}
+
+// the generic driver doing the same job, printed under the generated one
+void print_sim_bench_generic( FILE *fp, const char *call ) {
+  fprintf( fp, "  mark();\n");
+  fprintf( fp, "  generic_table_reads=0;\n");
+  fprintf( fp, "  %s;\n", call );
+  fprintf( fp, "  printf( \"    %%-34s %%6.1f loads %%6.1f stores %%7.1f cycles (%%lu table reads)\\n\",\n");
+  fprintf( fp, "          \"generic pin-table driver\", (double)(sim::loads-mark_loads),\n");
+  fprintf( fp, "          (double)(sim::stores-mark_stores), (double)(sim::cycles-mark_cycles), generic_table_reads );\n");
+}
+
+void print_sim_generic_pin( FILE *fp, const char *role, int pin ) {
+  if(pin<0) fprintf( fp, "  { 0xff, 0 },    // %s unused\n", role );
+  else      fprintf( fp, "  { %d, %2d },     // %s %s\n", pins[pin].port, pins[pin].bit, role, pins[pin].signame );
+}
+
+void print_sim_generic_spi( FILE *fp ) {
+  fprintf( fp, "// mode 0, MSB first\n");
+  fprintf( fp, "static uint8_t generic_spi_xfer( const GenericSpi *b, uint8_t out ) {\n");
+  fprintf( fp, "  int i;\n");
+  fprintf( fp, "  uint8_t in=0;\n");
+  fprintf( fp, "  for(i=0;i<8;i++) {\n");
+  fprintf( fp, "    generic_write( &b->mosi, out & 0x80 );\n");
+  fprintf( fp, "    out <<= 1;\n");
+  fprintf( fp, "    generic_write( &b->clk, 1 );\n");
+  fprintf( fp, "    in = (in<<1) | generic_read( &b->miso );\n");
+  fprintf( fp, "    generic_write( &b->clk, 0 );\n");
+  fprintf( fp, "  }\n");
+  fprintf( fp, "  return in;\n");
+  fprintf( fp, "}\n");
+  fprintf( fp, "\n");
+}
+
+void print_sim_generic_i2c( FILE *fp ) {
+  fprintf( fp, "static void generic_i2c_start( const GenericI2c *b ) {\n");
+  fprintf( fp, "  generic_write( &b->sda, 1 );\n");
+  fprintf( fp, "  generic_write( &b->scl, 1 );\n");
+  fprintf( fp, "  generic_write( &b->sda, 0 );\n");
+  fprintf( fp, "  generic_write( &b->scl, 0 );\n");
+  fprintf( fp, "}\n");
+  fprintf( fp, "\n");
+  fprintf( fp, "static void generic_i2c_stop( const GenericI2c *b ) {\n");
+  fprintf( fp, "  generic_write( &b->sda, 0 );\n");
+  fprintf( fp, "  generic_write( &b->scl, 1 );\n");
+  fprintf( fp, "  generic_write( &b->sda, 1 );\n");
+  fprintf( fp, "}\n");
+  fprintf( fp, "\n");
+  fprintf( fp, "// 0 on ACK\n");
+  fprintf( fp, "static int generic_i2c_write( const GenericI2c *b, uint8_t out ) {\n");
+  fprintf( fp, "  int i, nak;\n");
+  fprintf( fp, "  for(i=0;i<8;i++) {\n");
+  fprintf( fp, "    generic_write( &b->sda, out & 0x80 );\n");
+  fprintf( fp, "    out <<= 1;\n");
+  fprintf( fp, "    generic_write( &b->scl, 1 );\n");
+  fprintf( fp, "    generic_write( &b->scl, 0 );\n");
+  fprintf( fp, "  }\n");
+  fprintf( fp, "  generic_write( &b->sda, 1 );\n");
+  fprintf( fp, "  generic_write( &b->scl, 1 );\n");
+  fprintf( fp, "  nak = generic_read( &b->sda );\n");
+  fprintf( fp, "  generic_write( &b->scl, 0 );\n");
+  fprintf( fp, "  return nak;\n");
+  fprintf( fp, "}\n");
+  fprintf( fp, "\n");
+  fprintf( fp, "static uint8_t generic_i2c_read( const GenericI2c *b, int ack ) {\n");
+  fprintf( fp, "  int i;\n");
+  fprintf( fp, "  uint8_t in=0;\n");
+  fprintf( fp, "  generic_write( &b->sda, 1 );\n");
+  fprintf( fp, "  for(i=0;i<8;i++) {\n");
+  fprintf( fp, "    generic_write( &b->scl, 1 );\n");
+  fprintf( fp, "    in = (in<<1) | generic_read( &b->sda );\n");
+  fprintf( fp, "    generic_write( &b->scl, 0 );\n");
+  fprintf( fp, "  }\n");
+  fprintf( fp, "  if(ack) generic_write( &b->sda, 0 );\n");
+  fprintf( fp, "  generic_write( &b->scl, 1 );\n");
+  fprintf( fp, "  generic_write( &b->scl, 0 );\n");
+  fprintf( fp, "  generic_write( &b->sda, 1 );\n");
+  fprintf( fp, "  return in;\n");
+  fprintf( fp, "}\n");
+  fprintf( fp, "\n");
+}
+
+// Reference for the SOFTBUS routines: the usual hand-written generic
+// bit-bang driver, whose pins are port/bit table entries looked up on
+// every access, digitalWrite() style, with a branch per data bit.  The
+// model only sees register accesses, so each table entry and port base
+// read is counted here and charged at cycles_per_load; the generated
+// routines have none.
+void print_sim_generic( FILE *fp ) {
+  int j;
+  char bus[MAXCHARS];
+  SOFTBUSDEF *sb;
+  fprintf( fp, "struct GenericPin { uint8_t port, bit; };   // port 0xff: not connected\n");
+  fprintf( fp, "struct GenericSpi { GenericPin clk, mosi, miso; };\n");
+  fprintf( fp, "struct GenericI2c { GenericPin sda, scl; };\n");
+  fprintf( fp, "static unsigned long generic_table_reads;\n");
+  fprintf( fp, "\n");
+  fprintf( fp, "static LPC_GPIO_TypeDef *generic_port( const GenericPin *p ) {\n");
+  fprintf( fp, "  static LPC_GPIO_TypeDef * const ports[5] = { LPC_GPIO0, LPC_GPIO1, LPC_GPIO2, LPC_GPIO3, LPC_GPIO4 };\n");
+  fprintf( fp, "  generic_table_reads++;   // the entry\n");
+  fprintf( fp, "  sim::cycles += sim::cycles_per_load;\n");
+  fprintf( fp, "  if(p->port>4) return NULL;\n");
+  fprintf( fp, "  generic_table_reads++;   // the port base\n");
+  fprintf( fp, "  sim::cycles += sim::cycles_per_load;\n");
+  fprintf( fp, "  return ports[p->port];\n");
+  fprintf( fp, "}\n");
+  fprintf( fp, "\n");
+  fprintf( fp, "static void generic_write( const GenericPin *p, int level ) {\n");
+  fprintf( fp, "  LPC_GPIO_TypeDef *g=generic_port( p );\n");
+  fprintf( fp, "  if(!g) return;\n");
+  fprintf( fp, "  if(level) g->FIOSET = 1UL<<p->bit;\n");
+  fprintf( fp, "  else      g->FIOCLR = 1UL<<p->bit;\n");
+  fprintf( fp, "}\n");
+  fprintf( fp, "\n");
+  fprintf( fp, "static int generic_read( const GenericPin *p ) {\n");
+  fprintf( fp, "  LPC_GPIO_TypeDef *g=generic_port( p );\n");
+  fprintf( fp, "  if(!g) return 0;\n");
+  fprintf( fp, "  return (g->FIOPIN >> p->bit) & 1;\n");
+  fprintf( fp, "}\n");
+  fprintf( fp, "\n");
+  if(any_softbus_type( SB_SPI )) print_sim_generic_spi( fp );
+  if(any_softbus_type( SB_I2C )) print_sim_generic_i2c( fp );
+  for(j=0;j<nsoftbus;j++) {
+    sb=&softbus[j];
+    if(!sb->valid) continue;
+    softbus_ident( bus, sb, false );
+    if(sb->type==SB_SPI) {
+      fprintf( fp, "static const GenericSpi generic_%s = {\n", bus );
+      print_sim_generic_pin( fp, "CLK", sb->pin[SB_CLK] );
+      print_sim_generic_pin( fp, "MOSI", sb->pin[SB_MOSI] );
+      print_sim_generic_pin( fp, "MISO", sb->pin[SB_MISO] );
+    } else {
+      fprintf( fp, "static const GenericI2c generic_%s = {\n", bus );
+      print_sim_generic_pin( fp, "SDA", sb->pin[SB_SDA] );
+      print_sim_generic_pin( fp, "SCL", sb->pin[SB_SCL] );
+    }
+    fprintf( fp, "};\n");
+  }
+  fprintf( fp, "\n");
+}
+
+void print_sim_routines( FILE *fp ) {
+  int j;
+  char call[MAXCHARS], name[MAXCHARS], bus[MAXCHARS];
+
+  if(opt_bulk) {
+    sprintf( name, "%s_gpio_all_off", prefix );
+    sprintf( call, "%s()", name );
+    print_sim_bench( fp, call, name );
+    sprintf( name, "%s_gpio_restore_defaults", prefix );
+    sprintf( call, "%s()", name );
+    print_sim_bench( fp, call, name );
+    fprintf( fp, "  check_pins();\n");
+  }
+  if(opt_snapshot) {
+    fprintf( fp, "  {\n");
+    fprintf( fp, "    %s_GPIO_SNAPSHOT snap;\n", PREFIX );
+    fprintf( fp, "    mark();\n");
+    fprintf( fp, "    %s_gpio_sample( &snap );\n", prefix );
+    fprintf( fp, "    bench( \"%s_gpio_sample\", 1 );\n", prefix );
+    fprintf( fp, "  }\n");
+  }
+  if(opt_txn) {
+    sprintf( name, "%s_gpio_begin", prefix );
+    sprintf( call, "%s()", name );
+    print_sim_bench( fp, call, name );
+    sprintf( name, "%s_gpio_commit", prefix );
+    sprintf( call, "%s()", name );
+    print_sim_bench( fp, call, name );
+  }
+  if(any_irq()) {
+    sprintf( name, "%s_gpio_irq_init", prefix );
+    sprintf( call, "%s()", name );
+    print_sim_bench( fp, call, name );
+  }
+  if(any_debounce()) {
+    sprintf( name, "%s_gpio_debounce_init", prefix );
+    sprintf( call, "%s()", name );
+    print_sim_bench( fp, call, name );
+    sprintf( name, "%s_gpio_debounce_tick", prefix );
+    sprintf( call, "%s()", name );
+    print_sim_bench( fp, call, name );
+  }
+  if(pwm_channel_mask()) {
+    fprintf( fp, "  {\n");
+    fprintf( fp, "    uint32_t duty[%s_PWM_NCHANNELS] = { 0 };\n", PREFIX );
+    fprintf( fp, "    mark();\n");
+    fprintf( fp, "    %s_gpio_pwm_update( duty );\n", prefix );
+    fprintf( fp, "    bench( \"%s_gpio_pwm_update\", 1 );\n", prefix );
+    fprintf( fp, "  }\n");
+  }
+  for(j=0;j<nsoftbus;j++) {
+    if(!softbus[j].valid) continue;
+    softbus_ident( bus, &softbus[j], false );
+    if(softbus[j].type==SB_SPI) {
+      sprintf( name, "%s_gpio_%s_xfer", prefix, bus );
+      sprintf( call, "%s( 0xa5 )", name );
+      print_sim_bench( fp, call, name );
+      sprintf( call, "generic_spi_xfer( &generic_%s, 0xa5 )", bus );
+      print_sim_bench_generic( fp, call );
+    } else {
+      sprintf( name, "%s_gpio_%s_start", prefix, bus );
+      sprintf( call, "%s()", name );
+      print_sim_bench( fp, call, name );
+      sprintf( call, "generic_i2c_start( &generic_%s )", bus );
+      print_sim_bench_generic( fp, call );
+      sprintf( name, "%s_gpio_%s_write", prefix, bus );
+      sprintf( call, "%s( 0xa5 )", name );
+      print_sim_bench( fp, call, name );
+      sprintf( call, "generic_i2c_write( &generic_%s, 0xa5 )", bus );
+      print_sim_bench_generic( fp, call );
+      sprintf( name, "%s_gpio_%s_read", prefix, bus );
+      sprintf( call, "%s( 1 )", name );
+      print_sim_bench( fp, call, name );
+      sprintf( call, "generic_i2c_read( &generic_%s, 1 )", bus );
+      print_sim_bench_generic( fp, call );
+      sprintf( name, "%s_gpio_%s_stop", prefix, bus );
+      sprintf( call, "%s()", name );
+      print_sim_bench( fp, call, name );
+      sprintf( call, "generic_i2c_stop( &generic_%s )", bus );
+      print_sim_bench_generic( fp, call );
+    }
+  }
+}
+
+// Built with PREFIX_TRACE too, check what the first output's macros log,
+// and that a reader lapped by the writer gets only whole entries.
+void print_sim_trace( FILE *fp ) {
+  int i;
+  PINDEF *pd=NULL;
+  for(i=0;i<nseqs;i++) {
+    if(sim_gpio_out(&pins[i])) {
+      pd=&pins[i];
+      break;
+    }
+  }
+  if(!pd) return;
+  fprintf( fp, "#ifdef %s_TRACE\n", PREFIX );
+  fprintf( fp, "  {\n");
+  fprintf( fp, "    static %s_TRACE_ENTRY e[%s_TRACE_DEPTH];\n", PREFIX, PREFIX );
+  fprintf( fp, "    uint32_t tail=0;\n");
+  fprintf( fp, "    %s_CLR_%s;\n", PREFIX, pd->signame );
+  fprintf( fp, "    %s_gpio_trace_init();\n", prefix );
+  fprintf( fp, "    %s_SET_%s;\n", PREFIX, pd->signame );
+  fprintf( fp, "    %s_CLR_%s;\n", PREFIX, pd->signame );
+  fprintf( fp, "    %s_CLR_%s;\n", PREFIX, pd->signame );
+  fprintf( fp, "    check( %s_gpio_trace_read( &tail, e, %s_TRACE_DEPTH ) == 3, \"trace: entries\" );\n", prefix, PREFIX );
+  fprintf( fp, "    check( (e[0].pin == %d) && (e[0].level == 1) && (e[1].level == 0), \"trace: pin and level\" );\n", i );
+  fprintf( fp, "    check( e[1].time > e[0].time, \"trace: time\" );\n");
+  fprintf( fp, "    check( %s_gpio_trace_toggles[%d] == 2, \"trace: toggles\" );\n", prefix, i );
+  fprintf( fp, "    for(i=0;i<%s_TRACE_DEPTH+10;i++) %s_SET_%s;\n", PREFIX, PREFIX, pd->signame );
+  fprintf( fp, "    check( %s_gpio_trace_read( &tail, e, %s_TRACE_DEPTH ) == %s_TRACE_DEPTH-1, \"trace: lapped reader\" );\n", prefix, PREFIX, PREFIX );
+  fprintf( fp, "    check( tail == %s_gpio_trace_head, \"trace: tail\" );\n", prefix );
+  fprintf( fp, "    check( %s_gpio_trace_toggles[%d] == 3, \"trace: repeated level\" );\n", prefix, i );
+  fprintf( fp, "  }\n");
+  fprintf( fp, "#endif\n");
+}
+
+void print_sim_test( FILE *fp ) {
+  int i, j, port;
+  char call[MAXCHARS], name[MAXCHARS];
+
+  fprintf( fp, "\n");
+  fprintf( fp, "namespace sim = %s_sim;\n", prefix );
+  fprintf( fp, "\n");
+  fprintf( fp, "// the named port pins, traced in the VCD file\n");
+  fprintf( fp, "%s_sim::Signal %s_sim::signals[] = {\n", prefix, prefix );
+  for(i=0;i<nseqs;i++) {
+    if((pins[i].port>4) || (pins[i].bit>31) || (pins[i].signame[0]==0)) continue;
+    fprintf( fp, "  { %d, %2d, \"%s\", 0, 0 },\n", pins[i].port, pins[i].bit, pins[i].signame );
+  }
+  fprintf( fp, "  { -1, 0, NULL, 0, 0 }\n");
+  fprintf( fp, "};\n");
+  fprintf( fp, "const int %s_sim::nsignals = sizeof(%s_sim::signals)/sizeof(%s_sim::signals[0]) - 1;\n", prefix, prefix, prefix );
+  fprintf( fp, "\n");
+  fprintf( fp, "static int failures;\n");
+  fprintf( fp, "static unsigned long mark_loads, mark_stores, mark_cycles;\n");
+  fprintf( fp, "\n");
+  fprintf( fp, "static void check( int ok, const char *what ) {\n");
+  fprintf( fp, "  if(!ok) {\n");
+  fprintf( fp, "    printf( \"FAIL: %%s\\n\", what );\n");
+  fprintf( fp, "    failures++;\n");
+  fprintf( fp, "  }\n");
+  fprintf( fp, "}\n");
+  fprintf( fp, "\n");
+  fprintf( fp, "static void mark( void ) {\n");
+  fprintf( fp, "  mark_loads=sim::loads;\n");
+  fprintf( fp, "  mark_stores=sim::stores;\n");
+  fprintf( fp, "  mark_cycles=sim::cycles;\n");
+  fprintf( fp, "}\n");
+  fprintf( fp, "\n");
+  fprintf( fp, "// register accesses and model cycles per call since mark()\n");
+  fprintf( fp, "static void bench( const char *op, int ncalls ) {\n");
+  fprintf( fp, "  printf( \"  %%-36s %%6.1f loads %%6.1f stores %%7.1f cycles\\n\", op,\n");
+  fprintf( fp, "          (double)(sim::loads-mark_loads)/ncalls, (double)(sim::stores-mark_stores)/ncalls,\n");
+  fprintf( fp, "          (double)(sim::cycles-mark_cycles)/ncalls );\n");
+  fprintf( fp, "}\n");
+  fprintf( fp, "\n");
+  if(any_irq()) {
+    fprintf( fp, "// stand-ins for the application's pin interrupt handlers\n");
+    for(i=0;i<nseqs;i++) {
+      if(!pins[i].irq_edge) continue;
+      for(j=0;j<i;j++) {
+        if(pins[j].irq_edge && (0==strcmp(pins[j].irq_handler,pins[i].irq_handler))) break;
+      }
+      if(j<i) continue;
+      fprintf( fp, "__attribute__((weak)) void %s( void ) {}\n", pins[i].irq_handler );
+    }
+    fprintf( fp, "\n");
+  }
+  fprintf( fp, "// the header's reset images, one register at a time\n");
+  fprintf( fp, "void %s_sim_init( void ) {\n", prefix );
+  for(i=0;i<11;i++) fprintf( fp, "  LPC_PINCON->PINSEL%d = %s_PINSEL%d_INIT;\n", i, PREFIX, i );
+  for(i=0;i<10;i++) fprintf( fp, "  LPC_PINCON->PINMODE%d = %s_PINMODE%d_INIT;\n", i, PREFIX, i );
+  for(i=0;i<5;i++) fprintf( fp, "  LPC_PINCON->PINMODE_OD%d = %s_PINMODE_OD%d_INIT;\n", i, PREFIX, i );
+  for(port=0;port<5;port++) {
+    fprintf( fp, "  LPC_GPIO%d->FIOMASK = 0;\n", port );
+    fprintf( fp, "  LPC_GPIO%d->FIOPIN = %s_FIOPIN%d_INIT;\n", port, PREFIX, port );
+    fprintf( fp, "  LPC_GPIO%d->FIODIR = %s_FIODIR%d_INIT;\n", port, PREFIX, port );
+    fprintf( fp, "  LPC_GPIO%d->FIOMASK = %s_FIOMASK%d_INIT;\n", port, PREFIX, port );
+  }
+  fprintf( fp, "}\n");
+  fprintf( fp, "\n");
+  print_sim_check_pins( fp );
+  fprintf( fp, "\n");
+  if(any_softbus()) print_sim_generic( fp );
+  fprintf( fp, "int %s_sim_selftest( void ) {\n", prefix );
+  fprintf( fp, "  int i;\n");
+  fprintf( fp, "  failures=0;\n");
+  fprintf( fp, "  printf( \"Register accesses per call:\\n\" );\n");
+  if(opt_blockinit) {
+    fprintf( fp, "  sim::reset();\n");
+    sprintf( name, "%s_gpio_init_pincon", prefix );
+    sprintf( call, "%s()", name );
+    print_sim_bench( fp, call, name );
+    fprintf( fp, "  for(i=0;i<%s_PINSEL_NREGS;i++) check( (&sim::pincon.PINSEL0)[i].v == %s_PINSEL_IMAGE[i], \"init_pincon: PINSEL\" );\n", PREFIX, PREFIX );
+    fprintf( fp, "  for(i=0;i<%s_PINMODE_NREGS;i++) check( (&sim::pincon.PINMODE0)[i].v == %s_PINMODE_IMAGE[i], \"init_pincon: PINMODE\" );\n", PREFIX, PREFIX );
+  } else {
+    fprintf( fp, "  (void)i;\n");
+  }
+  fprintf( fp, "  sim::reset();\n");
+  fprintf( fp, "  mark();\n");
+  fprintf( fp, "  %s_sim_init();\n", prefix );
+  fprintf( fp, "  bench( \"init from the _INIT images\", 1 );\n");
+  fprintf( fp, "  check_pins();\n");
+  if(any_sleep()) {
+    sprintf( name, "%s_gpio_enter_sleep", prefix );
+    sprintf( call, "%s()", name );
+    print_sim_bench( fp, call, name );
+    sprintf( name, "%s_gpio_exit_sleep", prefix );
+    sprintf( call, "%s()", name );
+    print_sim_bench( fp, call, name );
+    fprintf( fp, "  check_pins();\n");
+  }
+  print_sim_macros( fp );
+  print_sim_routines( fp );
+  if(opt_trace) print_sim_trace( fp );
+  fprintf( fp, "  printf( \"%%d failures\\n\", failures );\n");
+  fprintf( fp, "  return failures;\n");
+  fprintf( fp, "}\n");
+  fprintf( fp, "\n");
+  fprintf( fp, "#ifndef %s_SIM_NO_MAIN\n", PREFIX );
+  fprintf( fp, "// %s_sim [file.vcd]\n", prefix );
+  fprintf( fp, "int main( int argc, char *argv[] ) {\n");
+  fprintf( fp, "  int n;\n");
+  fprintf( fp, "  if((argc>1) && !sim::vcd_open( argv[1] )) {\n");
+  fprintf( fp, "    fprintf(stderr,\"%s_sim: can't write %%s\\n\", argv[1] );\n", prefix );
+  fprintf( fp, "    return 99;\n");
+  fprintf( fp, "  }\n");
+  fprintf( fp, "  n=%s_sim_selftest();\n", prefix );
+  fprintf( fp, "  sim::vcd_close();\n");
+  fprintf( fp, "  printf( \"Register accesses since the last reset:\\n\" );\n");
+  fprintf( fp, "  sim::report( stdout );\n");
+  fprintf( fp, "  printf( \"Pin transitions since the last reset:\\n\" );\n");
+  fprintf( fp, "  sim::report_transitions( stdout );\n");
+  fprintf( fp, "  printf( \"%%lu cycles at %%lu/%%lu per load/store\\n\", sim::cycles, sim::cycles_per_load, sim::cycles_per_store );\n");
+  fprintf( fp, "  return n ? 1 : 0;\n");
+  fprintf( fp, "}\n");
+  fprintf( fp, "#endif\n");
+}
+
+
 //************************************************************************
 // General Purpose String trimming functions
 //************************************************************************
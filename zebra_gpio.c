@@ -2,7 +2,7 @@
 //************************************************************************
 //***
 //***  NOTE:  This file was automatically generated by MKPINS
-//***  Processing Date/Time:     Mon 24-Jun-2019 13:48:40
+//***  Processing Date/Time:     Sat 17-Oct-2026 02:54:07
 //***  Input Pin Info CSV file:  pinout.csv
 //***  Project Name Prefix:      ZEBRA
 //***  Output C-File:            zebra_gpio.c
@@ -2,7 +2,7 @@
 //************************************************************************
 //***
 //***  NOTE:  This file was automatically generated by MKPINS
-//***  Processing Date/Time:     Mon 24-Jun-2019 13:48:40
+//***  Processing Date/Time:     Sat 17-Oct-2026 02:54:07
 //***  Input Pin Info CSV file:  pinout.csv
 //***  Project Name Prefix:      ZEBRA
 //***  Output C-File:            zebra_gpio.c
@@ -90,8 +90,8 @@ extern const ZEBRA_PINDEF ZEBRA_MATCH2P1;
 #define NUM_PINDEFS (59)
 extern const ZEBRA_PINDEF* ZEBRA_PINS[NUM_PINDEFS];
 
-#define ZEBRA_PINSEL0_INIT (0xffffffffc0a00055)
-#define ZEBRA_PINSEL1_INIT (0x01400fff)
+#define ZEBRA_PINSEL0_INIT (0xc0a00055)
+#define ZEBRA_PINSEL1_INIT (0x0140003f)
 #define ZEBRA_PINSEL2_INIT (0x00000000)
 #define ZEBRA_PINSEL3_INIT (0x00000000)
 #define ZEBRA_PINSEL4_INIT (0x00000000)
@@ -137,6 +137,10 @@ extern const ZEBRA_PINDEF* ZEBRA_PINS[NUM_PINDEFS];
 #define ZEBRA_FIOMASK3_INIT (0xffffffff)
 #define ZEBRA_FIOMASK4_INIT (0xffffffff)
 
+// peripherals the pinout uses: UART0 I2C0 SPI CAN1 GPIO TIM2 I2C2
+#define ZEBRA_PCONP_INIT (0x0440a188)
+// powered at reset but routed nowhere: TIM0 TIM1 UART1 PWM1 SSP1 I2C1 SSP0
+
 #define ZEBRA_PIC_TXD_PORT                  (0)
 #define ZEBRA_PIC_TXD_BIT                   (0)
 #define ZEBRA_PIC_RXD_PORT                  (0)
@@ -608,6 +612,10 @@ extern const ZEBRA_PINDEF* ZEBRA_PINS[NUM_PINDEFS];
 #define ZEBRA_OFF_MATCH2P1                     (LPC_GPIO4->FIOCLR = (1<<29))
 #define ZEBRA_QON_MATCH2P1                    ((LPC_GPIO4->FIOPIN & (1<<29)) >> 29)
 
+#define ZEBRA_TIM2_MAT_MASK              (0x03)  // bit n = MAT2.n
+#define ZEBRA_TIM2_EMR_TOGGLE            (0x000000f0)
+#define ZEBRA_TIM2_MCR_INT               (0x00000009)
+
 //************************************************************************
 //***  Input Pin Info CSV file pinout.csv, printed below for reference:
 //************************************************************************